@@ -37,18 +37,25 @@
 #include <linux/cpuhotplug.h>
 #include <linux/sched/clock.h>
 #include <linux/sched/stat.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <soc/qcom/pm.h>
 #include <soc/qcom/event_timer.h>
 #include <soc/qcom/lpm_levels.h>
 #include <soc/qcom/lpm-stats.h>
+#include <soc/qcom/lpm_latency.h>
 #include <asm/arch_timer.h>
 #include <asm/suspend.h>
 #include <asm/cpuidle.h>
 #include "lpm-levels.h"
+#include "lpm-predict.h"
 #include <trace/events/power.h>
+#include <trace/events/ipi.h>
+#include <trace/events/irq.h>
 #include "../clk/clk.h"
 #define CREATE_TRACE_POINTS
 #include <trace/events/trace_msm_low_power.h>
+#include <trace/events/lpm_levels.h>
 
 #define SCLK_HZ (32768)
 #define PSCI_POWER_STATE(reset) (reset << 30)
@@ -65,34 +72,180 @@ struct lpm_cluster *lpm_root_node;
 static bool lpm_prediction = true;
 module_param_named(lpm_prediction, lpm_prediction, bool, 0664);
 
+static uint32_t lpm_history_depth = MAXSAMPLES;
+
+static int lpm_history_depth_set(const char *val,
+		const struct kernel_param *kp)
+{
+	uint32_t depth;
+	int ret;
+
+	ret = kstrtouint(val, 0, &depth);
+	if (ret)
+		return ret;
+
+	if (depth < 2 || depth > LPM_HISTORY_MAX)
+		return -EINVAL;
+
+	/* Each CPU starts over with the new depth on its next sample */
+	WRITE_ONCE(lpm_history_depth, depth);
+	return 0;
+}
+
+static const struct kernel_param_ops lpm_history_depth_ops = {
+	.set = lpm_history_depth_set,
+	.get = param_get_uint,
+};
+module_param_cb(lpm_history_depth, &lpm_history_depth_ops,
+		&lpm_history_depth, 0664);
+
 static uint32_t bias_hyst;
 module_param_named(bias_hyst, bias_hyst, uint, 0664);
 static bool lpm_ipi_prediction = true;
 module_param_named(lpm_ipi_prediction, lpm_ipi_prediction, bool, 0664);
+static bool lpm_periodic_prediction = true;
+module_param_named(lpm_periodic_prediction, lpm_periodic_prediction, bool,
+			0664);
+static uint32_t periodic_tolerance_us = 200;
+module_param_named(periodic_tolerance_us, periodic_tolerance_us, uint, 0664);
+static bool lpm_prewake;
+module_param_named(lpm_prewake, lpm_prewake, bool, 0664);
+static uint32_t prewake_margin_us = 100;
+module_param_named(prewake_margin_us, prewake_margin_us, uint, 0664);
+static bool lpm_exit_measure;
+module_param_named(lpm_exit_measure, lpm_exit_measure, bool, 0664);
+static bool lpm_measured_latency;
+module_param_named(lpm_measured_latency, lpm_measured_latency, bool, 0664);
+/* Deepest cluster level for clusters with latency-critical CPUs, -1 = none */
+static int lpm_latency_cluster_level;
+module_param_named(lpm_latency_cluster_level, lpm_latency_cluster_level, int,
+			0664);
+
+/* Latency-critical CPUs set from sysfs, and the union with all requests */
+static struct cpumask lpm_latency_user_cpus;
+static struct cpumask lpm_latency_cpus;
+static LIST_HEAD(lpm_latency_reqs);
+static DEFINE_SPINLOCK(lpm_latency_lock);
+
+static void lpm_latency_update_cpus(void)
+{
+	struct lpm_latency_req *req;
+	struct cpumask cpus;
+
+	lockdep_assert_held(&lpm_latency_lock);
+
+	cpumask_copy(&cpus, &lpm_latency_user_cpus);
+	list_for_each_entry(req, &lpm_latency_reqs, list)
+		cpumask_or(&cpus, &cpus, &req->cpus);
+
+	cpumask_copy(&lpm_latency_cpus, &cpus);
+}
+
+static int lpm_latency_cpus_set(const char *val,
+		const struct kernel_param *kp)
+{
+	struct cpumask cpus;
+	unsigned long flags;
+	int ret;
+
+	ret = cpulist_parse(val, &cpus);
+	if (ret)
+		return ret;
+
+	spin_lock_irqsave(&lpm_latency_lock, flags);
+	cpumask_copy(&lpm_latency_user_cpus, &cpus);
+	lpm_latency_update_cpus();
+	spin_unlock_irqrestore(&lpm_latency_lock, flags);
+
+	return 0;
+}
+
+static int lpm_latency_cpus_get(char *buf, const struct kernel_param *kp)
+{
+	return scnprintf(buf, PAGE_SIZE, "%*pbl\n",
+			cpumask_pr_args(&lpm_latency_user_cpus));
+}
+
+static const struct kernel_param_ops lpm_latency_cpus_ops = {
+	.set = lpm_latency_cpus_set,
+	.get = lpm_latency_cpus_get,
+};
+module_param_cb(lpm_latency_cpus, &lpm_latency_cpus_ops, NULL, 0664);
 
 struct lpm_history {
-	uint32_t resi[MAXSAMPLES];
-	int mode[MAXSAMPLES];
-	int nsamp;
-	uint32_t hptr;
+	struct lpm_ring resi;
 	uint32_t hinvalid;
 	uint32_t htmr_wkup;
 	int64_t stime;
 };
 
 struct ipi_history {
-	uint32_t interval[MAXSAMPLES];
-	uint32_t current_ptr;
+	struct lpm_ring interval;
 	ktime_t cpu_idle_resched_ts;
 };
 
 static DEFINE_PER_CPU(struct lpm_history, hist);
 static DEFINE_PER_CPU(struct ipi_history, cpu_ipi_history);
+static DEFINE_PER_CPU(struct lpm_periodic, periodic);
+static DEFINE_PER_CPU(struct lpm_prewake, prewake);
+
+#define WAKE_LOG_SIZE 64
+/* Interrupts later than this after an idle exit didn't cause it */
+#define WAKE_WINDOW_NS (100 * NSEC_PER_USEC)
+
+struct lpm_wake_entry {
+	uint64_t time_ns;
+	uint32_t residency_us;
+	int idx;
+	int source;
+	int irq;
+	/* Measured for timer wakes, otherwise what selection assumed */
+	uint32_t exit_us;
+	bool exit_measured;
+};
+
+struct lpm_wake_stats {
+	/* Idle exit waiting for the first interrupt after it */
+	bool pending;
+	int idx;
+	uint32_t residency_us;
+	uint64_t exit_ns;
+	/* Timer expiry and return from PSCI, if measuring exit latency */
+	uint64_t timer_ns;
+	uint64_t return_ns;
+	int cluster_level;
+
+	uint64_t count[NR_LPM_LEVELS][LPM_WAKE_MAX];
+	struct lpm_wake_entry log[WAKE_LOG_SIZE];
+	uint32_t log_head;
+};
+
+static DEFINE_PER_CPU(struct lpm_wake_stats, wake_stats);
+
+/* Samples needed before a measured latency replaces the DT one */
+#define EXIT_LAT_MIN_SAMPLES 64
+/* Timer wakes longer than this after the expiry weren't caused by it */
+#define EXIT_LAT_MAX_US (10 * USEC_PER_MSEC)
+
+struct lpm_exit_latency {
+	struct lpm_lat_hist cpu[NR_LPM_LEVELS];
+	/* Exits through a level of the CPU's cluster */
+	struct lpm_lat_hist cluster[NR_LPM_LEVELS];
+};
+
+static DEFINE_PER_CPU(struct lpm_exit_latency, exit_latency);
+/* Cluster level this CPU exited first as part of its idle exit, or -1 */
+static DEFINE_PER_CPU(int, exit_cluster_level);
 static DEFINE_PER_CPU(struct lpm_cpu*, cpu_lpm);
+/* Copy of the CPU level parameters used for selection */
+static DEFINE_PER_CPU(struct lpm_level_pwr [NR_LPM_LEVELS], cpu_pwr);
+/* The same with measured exit latencies where there are enough samples */
+static DEFINE_PER_CPU(struct lpm_level_pwr [NR_LPM_LEVELS], cpu_pwr_measured);
 static bool suspend_in_progress;
 static struct hrtimer lpm_hrtimer;
 static DEFINE_PER_CPU(struct hrtimer, histtimer);
 static DEFINE_PER_CPU(struct hrtimer, biastimer);
+static DEFINE_PER_CPU(struct hrtimer, prewaketimer);
 
 static void cluster_unprepare(struct lpm_cluster *cluster,
 		const struct cpumask *cpu, int child_idx, bool from_idle,
@@ -263,6 +416,50 @@ int lpm_get_latency(struct latency_level *level, uint32_t *latency)
 }
 EXPORT_SYMBOL(lpm_get_latency);
 
+/**
+ * lpm_latency_add_request - Mark CPUs as latency-critical
+ * @req: request, owned by the caller until removed
+ * @cpus: CPUs whose clusters stay out of deep cluster modes
+ * @name: shown in debugfs
+ */
+void lpm_latency_add_request(struct lpm_latency_req *req,
+		const struct cpumask *cpus, const char *name)
+{
+	unsigned long flags;
+
+	req->name = name;
+	cpumask_copy(&req->cpus, cpus);
+
+	spin_lock_irqsave(&lpm_latency_lock, flags);
+	list_add_tail(&req->list, &lpm_latency_reqs);
+	lpm_latency_update_cpus();
+	spin_unlock_irqrestore(&lpm_latency_lock, flags);
+}
+EXPORT_SYMBOL(lpm_latency_add_request);
+
+void lpm_latency_update_request(struct lpm_latency_req *req,
+		const struct cpumask *cpus)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lpm_latency_lock, flags);
+	cpumask_copy(&req->cpus, cpus);
+	lpm_latency_update_cpus();
+	spin_unlock_irqrestore(&lpm_latency_lock, flags);
+}
+EXPORT_SYMBOL(lpm_latency_update_request);
+
+void lpm_latency_remove_request(struct lpm_latency_req *req)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lpm_latency_lock, flags);
+	list_del(&req->list);
+	lpm_latency_update_cpus();
+	spin_unlock_irqrestore(&lpm_latency_lock, flags);
+}
+EXPORT_SYMBOL(lpm_latency_remove_request);
+
 static int lpm_dying_cpu(unsigned int cpu)
 {
 	struct lpm_cluster *cluster = per_cpu(cpu_lpm, cpu)->parent;
@@ -318,6 +515,47 @@ static void histtimer_start(uint32_t time_us)
 	hrtimer_start(cpu_histtimer, hist_ktime, HRTIMER_MODE_REL_PINNED);
 }
 
+static void prewaketimer_cancel(void)
+{
+	unsigned int cpu = raw_smp_processor_id();
+	struct lpm_prewake *pw = &per_cpu(prewake, cpu);
+
+	if (!pw->pending)
+		return;
+
+	hrtimer_try_to_cancel(&per_cpu(prewaketimer, cpu));
+	lpm_prewake_exit(pw);
+}
+
+static enum hrtimer_restart prewaketimer_fn(struct hrtimer *h)
+{
+	lpm_prewake_fired(this_cpu_ptr(&prewake), ktime_get_ns());
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Wakes the CPU from the selected level early enough to wait for the
+ * expected arrival in a shallow one.
+ */
+static void prewaketimer_start(const struct lpm_level_pwr *pwr_params,
+		int irq, uint64_t now_ns, uint64_t arrival_ns)
+{
+	struct hrtimer *cpu_prewaketimer = this_cpu_ptr(&prewaketimer);
+	uint64_t offset_ns, delay_ns;
+
+	offset_ns = (uint64_t)(pwr_params->exit_latency + prewake_margin_us) *
+			NSEC_PER_USEC;
+	delay_ns = lpm_prewake_arm(this_cpu_ptr(&prewake), irq, now_ns,
+			arrival_ns, offset_ns,
+			(uint64_t)pwr_params->min_residency * NSEC_PER_USEC);
+	if (!delay_ns)
+		return;
+
+	cpu_prewaketimer->function = prewaketimer_fn;
+	hrtimer_start(cpu_prewaketimer, ns_to_ktime(delay_ns),
+			HRTIMER_MODE_REL_PINNED);
+}
+
 static void cluster_timer_init(struct lpm_cluster *cluster)
 {
 	struct list_head *list;
@@ -412,60 +650,10 @@ static void biastimer_start(uint32_t time_ns)
 	hrtimer_start(cpu_biastimer, bias_ktime, HRTIMER_MODE_REL_PINNED);
 }
 
-static uint64_t find_deviation(int *interval, uint32_t ref_stddev,
-				int64_t *stime)
-{
-	int divisor, i;
-	uint64_t max, avg, stddev;
-	int64_t thresh = LLONG_MAX;
-
-	do {
-		max = avg = divisor = stddev = 0;
-		for (i = 0; i < MAXSAMPLES; i++) {
-			int64_t value = interval[i];
-
-			if (value <= thresh) {
-				avg += value;
-				divisor++;
-				if (value > max)
-					max = value;
-			}
-		}
-		do_div(avg, divisor);
-
-		for (i = 0; i < MAXSAMPLES; i++) {
-			int64_t value = interval[i];
-
-			if (value <= thresh) {
-				int64_t diff = value - avg;
-
-				stddev += diff * diff;
-			}
-		}
-		do_div(stddev, divisor);
-		stddev = int_sqrt(stddev);
-
-	/*
-	 * If the deviation is less, return the average, else
-	 * ignore one maximum sample and retry
-	 */
-		if (((avg > stddev * 6) && (divisor >= (MAXSAMPLES - 1)))
-					|| stddev <= ref_stddev) {
-			*stime = ktime_to_us(ktime_get()) + avg;
-			return avg;
-		}
-		thresh = max - 1;
-
-	} while (divisor > (MAXSAMPLES - 1));
-
-	return 0;
-}
-
 static uint64_t lpm_cpuidle_predict(struct cpuidle_device *dev,
 		struct lpm_cpu *cpu, int *idx_restrict,
 		uint32_t *idx_restrict_time, uint32_t *ipi_predicted)
 {
-	int i, j;
 	uint64_t avg;
 	struct lpm_history *history = &per_cpu(hist, dev->cpu);
 	struct ipi_history *ipi_history = &per_cpu(cpu_ipi_history, dev->cpu);
@@ -487,7 +675,7 @@ static uint64_t lpm_cpuidle_predict(struct cpuidle_device *dev,
 	/*
 	 * Predict only when all the samples are collected.
 	 */
-	if (history->nsamp < MAXSAMPLES) {
+	if (!lpm_ring_full(&history->resi)) {
 		history->stime = 0;
 		return 0;
 	}
@@ -499,59 +687,33 @@ static uint64_t lpm_cpuidle_predict(struct cpuidle_device *dev,
 	 * that mode.
 	 */
 
-	avg = find_deviation(history->resi, cpu->ref_stddev, &(history->stime));
-	if (avg)
+	avg = lpm_ring_deviation(&history->resi, cpu->ref_stddev);
+	if (avg) {
+		history->stime = ktime_to_us(ktime_get()) + avg;
 		return avg;
+	}
 
 	/*
 	 * Find the number of premature exits for each of the mode,
 	 * excluding clockgating mode, and they are more than fifty
 	 * percent restrict that and deeper modes.
 	 */
-	if (history->htmr_wkup != 1) {
-		for (j = 1; j < cpu->nlevels; j++) {
-			struct lpm_cpu_level *level = &cpu->levels[j];
-			uint32_t min_residency = level->pwr.min_residency;
-			uint32_t max_residency = 0;
-			struct lpm_cpu_level *lvl;
-			uint32_t failed = 0;
-			uint64_t total = 0;
-
-			for (i = 0; i < MAXSAMPLES; i++) {
-				if ((history->mode[i] == j) &&
-					(history->resi[i] < min_residency)) {
-					failed++;
-					total += history->resi[i];
-				}
-			}
-			if (failed >= cpu->ref_premature_cnt) {
-				*idx_restrict = j;
-				do_div(total, failed);
-				for (i = 0; i < j; i++) {
-					lvl = &cpu->levels[i];
-					max_residency = lvl->pwr.max_residency;
-					if (total < max_residency) {
-						*idx_restrict = i + 1;
-						total = max_residency;
-						break;
-					}
-				}
-
-				*idx_restrict_time = total;
-				history->stime = ktime_to_us(ktime_get())
-						+ *idx_restrict_time;
-				break;
-			}
-		}
-	}
+	if (history->htmr_wkup != 1 && lpm_ring_restrict(&history->resi,
+			per_cpu(cpu_pwr, dev->cpu), cpu->nlevels,
+			cpu->ref_premature_cnt, idx_restrict,
+			idx_restrict_time))
+		history->stime = ktime_to_us(ktime_get()) + *idx_restrict_time;
 
 	if (*idx_restrict_time || !cpu->ipi_prediction || !lpm_ipi_prediction)
 		return 0;
 
-	avg = find_deviation(ipi_history->interval, cpu->ref_stddev
-						+ DEFAULT_IPI_STDDEV,
-						&(history->stime));
+	if (!lpm_ring_full(&ipi_history->interval))
+		return 0;
+
+	avg = lpm_ring_deviation(&ipi_history->interval, cpu->ref_stddev
+						+ DEFAULT_IPI_STDDEV);
 	if (avg) {
+		history->stime = ktime_to_us(ktime_get()) + avg;
 		*ipi_predicted = 1;
 		return avg;
 	}
@@ -577,7 +739,6 @@ static inline void invalidate_predict_history(struct cpuidle_device *dev)
 static void clear_predict_history(void)
 {
 	struct lpm_history *history;
-	int i;
 	unsigned int cpu;
 	struct lpm_cpu *lpm_cpu = per_cpu(cpu_lpm, raw_smp_processor_id());
 
@@ -586,13 +747,8 @@ static void clear_predict_history(void)
 
 	for_each_possible_cpu(cpu) {
 		history = &per_cpu(hist, cpu);
-		for (i = 0; i < MAXSAMPLES; i++) {
-			history->resi[i]  = 0;
-			history->mode[i] = -1;
-			history->hptr = 0;
-			history->nsamp = 0;
-			history->stime = 0;
-		}
+		lpm_ring_init(&history->resi, READ_ONCE(lpm_history_depth));
+		history->stime = 0;
 	}
 }
 
@@ -616,6 +772,147 @@ static inline bool is_cpu_biased(int cpu, uint64_t *bias_time)
 	return false;
 }
 
+/* Returns false if the exit couldn't be timed */
+static bool lpm_exit_latency_add(struct lpm_wake_stats *ws, uint32_t *exit_us)
+{
+	struct lpm_exit_latency *lat = this_cpu_ptr(&exit_latency);
+	struct lpm_level_pwr *measured = this_cpu_ptr(cpu_pwr_measured);
+	struct lpm_lat_hist *hist;
+	uint64_t us;
+
+	if (ws->return_ns <= ws->timer_ns)
+		return false;
+
+	us = div_u64(ws->return_ns - ws->timer_ns, NSEC_PER_USEC);
+	if (us > EXIT_LAT_MAX_US)
+		return false;
+
+	*exit_us = us;
+	if (ws->cluster_level >= 0) {
+		lpm_lat_add(&lat->cluster[ws->cluster_level], us);
+		return true;
+	}
+
+	hist = &lat->cpu[ws->idx];
+	lpm_lat_add(hist, us);
+	if (hist->samples >= EXIT_LAT_MIN_SAMPLES && !(hist->samples % 16))
+		measured[ws->idx].exit_latency = lpm_lat_percentile(hist, 99);
+
+	return true;
+}
+
+static void lpm_wake_attribute(int source, int irq)
+{
+	struct lpm_wake_stats *ws = this_cpu_ptr(&wake_stats);
+	struct lpm_wake_entry *entry;
+	struct lpm_level_pwr *pwr;
+	uint32_t exit_us = 0;
+	bool measured = false;
+
+	if (!ws->pending)
+		return;
+
+	if (source != LPM_WAKE_NONE &&
+			ktime_get_ns() - ws->exit_ns > WAKE_WINDOW_NS) {
+		source = LPM_WAKE_NONE;
+		irq = -1;
+	}
+
+	ws->pending = false;
+	ws->count[ws->idx][source]++;
+
+	/* A timer wake has a known start, the expiry */
+	if (source == LPM_WAKE_TIMER && ws->timer_ns)
+		measured = lpm_exit_latency_add(ws, &exit_us);
+
+	if (!measured) {
+		pwr = lpm_measured_latency ? this_cpu_ptr(cpu_pwr_measured) :
+				this_cpu_ptr(cpu_pwr);
+		exit_us = pwr[ws->idx].exit_latency;
+	}
+
+	entry = &ws->log[ws->log_head++ % WAKE_LOG_SIZE];
+	entry->time_ns = ws->exit_ns;
+	entry->residency_us = ws->residency_us;
+	entry->idx = ws->idx;
+	entry->source = source;
+	entry->irq = irq;
+	entry->exit_us = exit_us;
+	entry->exit_measured = measured;
+
+	trace_cpu_idle_wake(ws->idx, ws->residency_us, source, irq);
+}
+
+/* Runs right after idle exit, when the wakeup interrupt is unmasked */
+static void lpm_wake_exit(int idx, uint32_t residency_us, uint64_t timer_ns,
+		uint64_t return_ns)
+{
+	struct lpm_wake_stats *ws = this_cpu_ptr(&wake_stats);
+
+	/* Nothing was handled after the last exit, e.g. need_resched() */
+	lpm_wake_attribute(LPM_WAKE_NONE, -1);
+
+	ws->pending = true;
+	ws->idx = idx;
+	ws->residency_us = residency_us;
+	ws->exit_ns = ktime_get_ns();
+	ws->timer_ns = timer_ns;
+	ws->return_ns = return_ns;
+	ws->cluster_level = this_cpu_read(exit_cluster_level);
+}
+
+static void lpm_ipi_entry(void *unused, const char *reason)
+{
+	lpm_wake_attribute(LPM_WAKE_IPI, -1);
+}
+
+static void lpm_irq_handler_entry(void *unused, int irq,
+		struct irqaction *action)
+{
+	uint64_t now_ns, tolerance_ns;
+
+	/* Per-CPU interrupts that wake CPUs are the arch timer */
+	lpm_wake_attribute(action->percpu_dev_id ? LPM_WAKE_TIMER :
+			LPM_WAKE_IRQ, irq);
+
+	/* Per-CPU timer interrupts are already covered by the sleep length */
+	if (!lpm_periodic_prediction || action->percpu_dev_id)
+		return;
+
+	now_ns = ktime_get_ns();
+	tolerance_ns = (uint64_t)periodic_tolerance_us * NSEC_PER_USEC;
+	lpm_periodic_irq(this_cpu_ptr(&periodic), irq, now_ns, tolerance_ns);
+	lpm_prewake_irq(this_cpu_ptr(&prewake), irq, now_ns, tolerance_ns);
+}
+
+struct cpu_select {
+	struct lpm_select sel;
+	struct cpuidle_device *dev;
+	struct lpm_cpu *cpu;
+};
+
+static bool cpu_select_allow(struct lpm_select *sel, int idx)
+{
+	struct cpu_select *cs = container_of(sel, struct cpu_select, sel);
+
+	return lpm_cpu_mode_allow(cs->dev->cpu, idx, true);
+}
+
+static uint64_t cpu_select_predict(struct lpm_select *sel)
+{
+	struct cpu_select *cs = container_of(sel, struct cpu_select, sel);
+
+	return lpm_cpuidle_predict(cs->dev, cs->cpu, &sel->idx_restrict,
+			&sel->idx_restrict_time, &sel->ipi_predicted);
+}
+
+static void cpu_select_invalidate(struct lpm_select *sel)
+{
+	struct cpu_select *cs = container_of(sel, struct cpu_select, sel);
+
+	invalidate_predict_history(cs->dev);
+}
+
 static int cpu_power_select(struct cpuidle_device *dev,
 		struct lpm_cpu *cpu)
 {
@@ -624,16 +921,22 @@ static int cpu_power_select(struct cpuidle_device *dev,
 							dev->cpu);
 	ktime_t delta_next;
 	s64 sleep_us = ktime_to_us(tick_nohz_get_sleep_length(&delta_next));
-	uint32_t modified_time_us = 0;
 	uint32_t next_event_us = 0;
-	int i, idx_restrict;
-	uint32_t lvl_latency_us = 0;
+	int idx_restrict;
 	uint64_t predicted = 0;
 	uint32_t htime = 0, idx_restrict_time = 0, ipi_predicted = 0;
-	uint32_t next_wakeup_us = (uint32_t)sleep_us;
+	uint32_t next_wakeup_us;
 	uint32_t min_residency, max_residency;
 	struct power_params *pwr_params;
 	uint64_t bias_time = 0;
+	uint64_t now_ns, periodic_ns = 0;
+	uint32_t periodic_us = 0;
+	int periodic_irq = -1;
+	bool periodic_predicted = false;
+	struct cpu_select cs = {
+		.dev = dev,
+		.cpu = cpu,
+	};
 
 	if ((sleep_disabled && !cpu_isolated(dev->cpu)) || sleep_us < 0)
 		return best_level;
@@ -647,64 +950,52 @@ static int cpu_power_select(struct cpuidle_device *dev,
 		goto done_select;
 	}
 
-	for (i = 0; i < cpu->nlevels; i++) {
-		bool allow;
-
-		allow = i ? lpm_cpu_mode_allow(dev->cpu, i, true) : true;
-
-		if (!allow)
-			continue;
-
-		pwr_params = &cpu->levels[i].pwr;
-		lvl_latency_us = pwr_params->exit_latency;
-		min_residency = pwr_params->min_residency;
-		max_residency = pwr_params->max_residency;
-
-		if (latency_us <= lvl_latency_us)
-			break;
-
-		if (next_event_us) {
-			if (next_event_us < lvl_latency_us)
-				break;
-
-			if (((next_event_us - lvl_latency_us) < sleep_us) ||
-					(next_event_us < sleep_us))
-				next_wakeup_us = next_event_us - lvl_latency_us;
-		}
-
-		if (!i && !cpu_isolated(dev->cpu)) {
-			/*
-			 * If the next_wake_us itself is not sufficient for
-			 * deeper low power modes than clock gating do not
-			 * call prediction.
-			 */
-			if (next_wakeup_us > max_residency) {
-				predicted = lpm_cpuidle_predict(dev, cpu,
-					&idx_restrict, &idx_restrict_time,
-					&ipi_predicted);
-				if (predicted && (predicted < min_residency))
-					predicted = min_residency;
-			} else
-				invalidate_predict_history(dev);
-		}
-
-		if (i >= idx_restrict)
-			break;
-
-		best_level = i;
-
-		if (next_event_us && next_event_us < sleep_us && !i)
-			modified_time_us = next_event_us - lvl_latency_us;
-		else
-			modified_time_us = 0;
-
-		if (predicted ? (predicted <= max_residency)
-			: (next_wakeup_us <= max_residency))
-			break;
+	now_ns = ktime_get_ns();
+	if (lpm_periodic_prediction && !cpu_isolated(dev->cpu)) {
+		periodic_ns = lpm_periodic_predict(&per_cpu(periodic, dev->cpu),
+				now_ns, &periodic_irq);
+		if (periodic_ns)
+			periodic_us = max_t(uint32_t,
+				div_u64(periodic_ns, NSEC_PER_USEC), 1);
 	}
 
-	if (modified_time_us)
-		msm_pm_set_timer(modified_time_us);
+	cs.sel.levels = lpm_measured_latency ?
+			per_cpu(cpu_pwr_measured, dev->cpu) :
+			per_cpu(cpu_pwr, dev->cpu);
+	cs.sel.nlevels = cpu->nlevels;
+	cs.sel.latency_us = latency_us;
+	cs.sel.sleep_us = sleep_us;
+	cs.sel.next_event_us = next_event_us;
+	cs.sel.periodic_us = periodic_us;
+	/* After a pre-wake, stay shallow for the rest of the margin */
+	cs.sel.periodic_guard_us = lpm_prewake ? prewake_margin_us : 0;
+	cs.sel.predict = !cpu_isolated(dev->cpu);
+	cs.sel.allow = cpu_select_allow;
+	cs.sel.predictor = cpu_select_predict;
+	cs.sel.invalidate = cpu_select_invalidate;
+
+	lpm_select_level(&cs.sel);
+
+	best_level = cs.sel.best_level;
+	idx_restrict = cs.sel.idx_restrict;
+	idx_restrict_time = cs.sel.idx_restrict_time;
+	ipi_predicted = cs.sel.ipi_predicted;
+	predicted = cs.sel.predicted;
+	next_wakeup_us = cs.sel.next_wakeup_us;
+	periodic_predicted = cs.sel.periodic_predicted;
+
+	if (cs.sel.modified_time_us)
+		msm_pm_set_timer(cs.sel.modified_time_us);
+
+	if (periodic_predicted) {
+		lpm_periodic_expect(&per_cpu(periodic, dev->cpu), periodic_irq,
+				now_ns + periodic_ns);
+
+		if (lpm_prewake && best_level)
+			prewaketimer_start(&cs.sel.levels[best_level],
+					periodic_irq, now_ns,
+					now_ns + periodic_ns);
+	}
 
 	/*
 	 * Start timer to avoid staying in shallower mode forever
@@ -733,8 +1024,9 @@ static int cpu_power_select(struct cpuidle_device *dev,
 done_select:
 	trace_cpu_power_select(best_level, sleep_us, latency_us, next_event_us);
 
-	trace_cpu_pred_select(idx_restrict_time ? 2 : (ipi_predicted ?
-				3 : (predicted ? 1 : 0)), predicted, htime);
+	trace_cpu_pred_select(periodic_predicted ? 4 : (idx_restrict_time ? 2 :
+			(ipi_predicted ? 3 : (predicted ? 1 : 0))), predicted,
+			htime);
 
 	return best_level;
 }
@@ -968,10 +1260,16 @@ static int cluster_select(struct lpm_cluster *cluster, bool from_idle,
 	uint32_t sleep_us;
 	uint32_t cpupred_us = 0, pred_us = 0;
 	int pred_mode = 0, predicted = 0;
+	int max_level;
 
 	if (!cluster)
 		return -EINVAL;
 
+	max_level = cluster->nlevels - 1;
+	if (from_idle && cpumask_intersects(&cluster->child_cpus,
+					&lpm_latency_cpus))
+		max_level = min(max_level, lpm_latency_cluster_level);
+
 	sleep_us = (uint32_t)get_cluster_sleep_time(cluster,
 						from_idle, &cpupred_us);
 
@@ -992,7 +1290,7 @@ static int cluster_select(struct lpm_cluster *cluster, bool from_idle,
 		latency_us = pm_qos_request_for_cpumask(PM_QOS_CPU_DMA_LATENCY,
 							&mask);
 
-	for (i = 0; i < cluster->nlevels; i++) {
+	for (i = 0; i <= max_level; i++) {
 		struct lpm_cluster_level *level = &cluster->levels[i];
 		struct power_params *pwr_params = &level->pwr;
 
@@ -1221,6 +1519,10 @@ static void cluster_unprepare(struct lpm_cluster *cluster,
 
 	level = &cluster->levels[cluster->last_level];
 
+	/* The first CPU out pays for the exit of the innermost cluster */
+	if (from_idle && this_cpu_read(exit_cluster_level) < 0)
+		this_cpu_write(exit_cluster_level, cluster->last_level);
+
 	if (level->notify_rpm)
 		if (sys_pm_ops && sys_pm_ops->exit)
 			sys_pm_ops->exit(success);
@@ -1364,49 +1666,48 @@ static int lpm_cpuidle_select(struct cpuidle_driver *drv,
 void update_ipi_history(int cpu)
 {
 	struct ipi_history *history = &per_cpu(cpu_ipi_history, cpu);
+	uint32_t depth = READ_ONCE(lpm_history_depth);
 	ktime_t now = ktime_get();
 
-	history->interval[history->current_ptr] =
-			ktime_to_us(ktime_sub(now,
-			history->cpu_idle_resched_ts));
-	(history->current_ptr)++;
-	if (history->current_ptr >= MAXSAMPLES)
-		history->current_ptr = 0;
+	if (history->interval.depth != depth)
+		lpm_ring_init(&history->interval, depth);
+
+	lpm_ring_push(&history->interval, min_t(s64, ktime_to_us(ktime_sub(now,
+			history->cpu_idle_resched_ts)), U32_MAX), -1, false);
 	history->cpu_idle_resched_ts = now;
 }
 
 static void update_history(struct cpuidle_device *dev, int idx)
 {
 	struct lpm_history *history = &per_cpu(hist, dev->cpu);
-	uint32_t tmr = 0;
+	struct lpm_ring *resi = &history->resi;
+	uint32_t depth = READ_ONCE(lpm_history_depth);
+	uint32_t tmr = 0, newest;
 	struct lpm_cpu *lpm_cpu = per_cpu(cpu_lpm, dev->cpu);
+	bool premature;
 
 	if (!lpm_prediction || !lpm_cpu->lpm_prediction)
 		return;
 
-	if (history->htmr_wkup) {
-		if (!history->hptr)
-			history->hptr = MAXSAMPLES-1;
-		else
-			history->hptr--;
+	if (resi->depth != depth) {
+		lpm_ring_init(resi, depth);
+		history->htmr_wkup = 0;
+	}
 
-		history->resi[history->hptr] += dev->last_residency;
+	if (history->htmr_wkup) {
+		newest = lpm_ring_newest(resi) + dev->last_residency;
+		premature = idx && newest < lpm_cpu->levels[idx].pwr.min_residency;
+		lpm_ring_amend(resi, dev->last_residency, idx, premature);
 		history->htmr_wkup = 0;
 		tmr = 1;
-	} else
-		history->resi[history->hptr] = dev->last_residency;
-
-	history->mode[history->hptr] = idx;
-
-	trace_cpu_pred_hist(history->mode[history->hptr],
-		history->resi[history->hptr], history->hptr, tmr);
-
-	if (history->nsamp < MAXSAMPLES)
-		history->nsamp++;
+	} else {
+		premature = idx && dev->last_residency <
+				lpm_cpu->levels[idx].pwr.min_residency;
+		lpm_ring_push(resi, dev->last_residency, idx, premature);
+	}
 
-	(history->hptr)++;
-	if (history->hptr >= MAXSAMPLES)
-		history->hptr = 0;
+	trace_cpu_pred_hist(idx, lpm_ring_newest(resi),
+		lpm_ring_slot(resi, resi->seq - 1), tmr);
 }
 
 static int lpm_cpuidle_enter(struct cpuidle_device *dev,
@@ -1417,6 +1718,7 @@ static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 	const struct cpumask *cpumask = get_cpu_mask(dev->cpu);
 	ktime_t start = ktime_get();
 	uint64_t start_time = ktime_to_ns(start), end_time;
+	uint64_t timer_ns = 0;
 
 	cpu_prepare(cpu, idx, true);
 	cluster_prepare(cpu->parent, cpumask, idx, true, start_time);
@@ -1427,17 +1729,24 @@ static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 	if (need_resched())
 		goto exit;
 
+	/* The timer that will wake us, if nothing else does first */
+	if (lpm_exit_measure)
+		timer_ns = ktime_to_ns(*get_next_event_cpu(dev->cpu));
+
 	success = psci_enter_sleep(cpu, idx, true);
 
 exit:
 	end_time = ktime_to_ns(ktime_get());
 	lpm_stats_cpu_exit(idx, end_time, success);
 
+	this_cpu_write(exit_cluster_level, -1);
 	cluster_unprepare(cpu->parent, cpumask, idx, true, end_time, success);
 	cpu_unprepare(cpu, idx, true);
 	dev->last_residency = ktime_us_delta(ktime_get(), start);
 	update_history(dev, idx);
 	trace_cpu_idle_exit(idx, success);
+	if (success)
+		lpm_wake_exit(idx, dev->last_residency, timer_ns, end_time);
 	if (lpm_prediction && cpu->lpm_prediction) {
 		histtimer_cancel();
 		clusttimer_cancel();
@@ -1446,6 +1755,7 @@ exit:
 		biastimer_cancel();
 		cpu->bias = 0;
 	}
+	prewaketimer_cancel();
 	local_irq_enable();
 	return idx;
 }
@@ -1524,6 +1834,21 @@ static struct cpuidle_governor lpm_governor = {
 	.select =	lpm_cpuidle_select,
 };
 
+static void cpu_pwr_init(struct lpm_cpu *lpm_cpu, unsigned int cpu)
+{
+	struct lpm_level_pwr *pwr = per_cpu(cpu_pwr, cpu);
+	int i;
+
+	for (i = 0; i < lpm_cpu->nlevels; i++) {
+		pwr[i].exit_latency = lpm_cpu->levels[i].pwr.exit_latency;
+		pwr[i].min_residency = lpm_cpu->levels[i].pwr.min_residency;
+		pwr[i].max_residency = lpm_cpu->levels[i].pwr.max_residency;
+	}
+
+	memcpy(per_cpu(cpu_pwr_measured, cpu), pwr,
+			sizeof(struct lpm_level_pwr) * NR_LPM_LEVELS);
+}
+
 static int cluster_cpuidle_register(struct lpm_cluster *cl)
 {
 	int i = 0, ret = 0;
@@ -1566,8 +1891,10 @@ static int cluster_cpuidle_register(struct lpm_cluster *cl)
 
 		lpm_cpu->drv->state_count = lpm_cpu->nlevels;
 		lpm_cpu->drv->safe_state_index = 0;
-		for_each_cpu(cpu, &lpm_cpu->related_cpus)
+		for_each_cpu(cpu, &lpm_cpu->related_cpus) {
 			per_cpu(cpu_lpm, cpu) = lpm_cpu;
+			cpu_pwr_init(lpm_cpu, cpu);
+		}
 
 		for_each_possible_cpu(cpu) {
 			if (cpu_online(cpu))
@@ -1716,6 +2043,312 @@ static const struct platform_s2idle_ops lpm_s2idle_ops = {
 	.restore = lpm_suspend_wake,
 };
 
+static int lpm_periodic_show(struct seq_file *m, void *unused)
+{
+	unsigned int cpu;
+	int i;
+
+	for_each_possible_cpu(cpu) {
+		struct lpm_periodic *p = &per_cpu(periodic, cpu);
+
+		seq_printf(m, "cpu%u: predictions %llu hits %llu early %llu late %llu missed %llu\n",
+				cpu, p->predictions, p->hits, p->early,
+				p->late, p->missed);
+
+		for (i = 0; i < LPM_PERIODIC_SRCS; i++) {
+			struct lpm_periodic_src *src = &p->src[i];
+
+			if (src->irq < 0 || !src->period_ns)
+				continue;
+
+			seq_printf(m, "\tirq %d period %llu us confidence %u%s\n",
+					src->irq,
+					div_u64(src->period_ns, NSEC_PER_USEC),
+					src->confidence,
+					src->confidence >= LPM_PERIODIC_LOCK ?
+					" (locked)" : "");
+		}
+	}
+
+	return 0;
+}
+
+static int lpm_periodic_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpm_periodic_show, NULL);
+}
+
+static const struct file_operations lpm_periodic_fops = {
+	.open = lpm_periodic_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int lpm_prewake_show(struct seq_file *m, void *unused)
+{
+	unsigned int cpu;
+
+	seq_printf(m, "%s, margin %u us\n",
+			lpm_prewake ? "enabled" : "disabled", prewake_margin_us);
+
+	for_each_possible_cpu(cpu) {
+		struct lpm_prewake *pw = &per_cpu(prewake, cpu);
+		uint64_t woken = pw->on_time + pw->early;
+
+		seq_printf(m, "cpu%u: armed %llu on time %llu early %llu late %llu avg lead %llu us\n",
+				cpu, pw->armed, pw->on_time, pw->early,
+				pw->late, woken ? div64_u64(pw->lead_ns,
+				woken * NSEC_PER_USEC) : 0);
+	}
+
+	return 0;
+}
+
+static int lpm_prewake_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpm_prewake_show, NULL);
+}
+
+static const struct file_operations lpm_prewake_fops = {
+	.open = lpm_prewake_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int lpm_wakeups_show(struct seq_file *m, void *unused)
+{
+	unsigned int cpu;
+	int i, j;
+
+	seq_printf(m, "%-6s %-16s", "cpu", "state");
+	for (j = 0; j < LPM_WAKE_MAX; j++)
+		seq_printf(m, " %10s", lpm_wake_names[j]);
+	seq_puts(m, "\n");
+
+	for_each_possible_cpu(cpu) {
+		struct lpm_cpu *lpm_cpu = per_cpu(cpu_lpm, cpu);
+		struct lpm_wake_stats *ws = &per_cpu(wake_stats, cpu);
+
+		if (!lpm_cpu)
+			continue;
+
+		for (i = 0; i < lpm_cpu->nlevels; i++) {
+			seq_printf(m, "cpu%-3u %-16s", cpu,
+					lpm_cpu->levels[i].name);
+			for (j = 0; j < LPM_WAKE_MAX; j++)
+				seq_printf(m, " %10llu", ws->count[i][j]);
+			seq_puts(m, "\n");
+		}
+	}
+
+	return 0;
+}
+
+static int lpm_wakeups_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpm_wakeups_show, NULL);
+}
+
+static const struct file_operations lpm_wakeups_fops = {
+	.open = lpm_wakeups_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* Most recent wakeups, oldest first, with the exit latency they cost */
+static int lpm_wake_log_show(struct seq_file *m, void *unused)
+{
+	unsigned int cpu;
+	uint32_t i, start;
+
+	seq_printf(m, "%-6s %16s %-16s %12s %-6s %5s %10s %s\n", "cpu",
+			"time_ns", "state", "residency_us", "source", "irq",
+			"exit_us", "exit_from");
+
+	for_each_possible_cpu(cpu) {
+		struct lpm_cpu *lpm_cpu = per_cpu(cpu_lpm, cpu);
+		struct lpm_wake_stats *ws = &per_cpu(wake_stats, cpu);
+		uint32_t head = READ_ONCE(ws->log_head);
+
+		if (!lpm_cpu)
+			continue;
+
+		start = head > WAKE_LOG_SIZE ? head - WAKE_LOG_SIZE : 0;
+		for (i = start; i < head; i++) {
+			struct lpm_wake_entry *entry =
+				&ws->log[i % WAKE_LOG_SIZE];
+
+			if (entry->idx >= lpm_cpu->nlevels)
+				continue;
+
+			seq_printf(m, "cpu%-3u %16llu %-16s %12u %-6s %5d %10u %s\n",
+				cpu, entry->time_ns,
+				lpm_cpu->levels[entry->idx].name,
+				entry->residency_us,
+				lpm_wake_names[entry->source], entry->irq,
+				entry->exit_us,
+				entry->exit_measured ? "measured" : "selection");
+		}
+	}
+
+	return 0;
+}
+
+static int lpm_wake_log_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpm_wake_log_show, NULL);
+}
+
+static const struct file_operations lpm_wake_log_fops = {
+	.open = lpm_wake_log_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void lpm_exit_latency_show_hist(struct seq_file *m, const char *name,
+		uint32_t dt_us, const struct lpm_lat_hist *hist,
+		uint32_t effective_us)
+{
+	int i;
+
+	seq_printf(m, "  %-16s %8u %10llu %8u %8u %8u %10u\n", name, dt_us,
+			hist->samples, lpm_lat_percentile(hist, 50),
+			lpm_lat_percentile(hist, 99), hist->max, effective_us);
+
+	for (i = 0; i < LPM_LAT_BUCKETS; i++) {
+		if (!hist->count[i])
+			continue;
+
+		seq_printf(m, "    <= %4u us: %u\n", lpm_lat_bucket_us(i),
+				hist->count[i]);
+	}
+}
+
+static int lpm_exit_latency_show(struct seq_file *m, void *unused)
+{
+	struct lpm_lat_hist *hist;
+	unsigned int cpu, c;
+	int i;
+
+	hist = kmalloc(sizeof(*hist), GFP_KERNEL);
+	if (!hist)
+		return -ENOMEM;
+
+	seq_printf(m, "measuring: %s, selection uses %s latencies\n",
+			lpm_exit_measure ? "yes" : "no",
+			lpm_measured_latency ? "measured" : "DT");
+
+	for_each_possible_cpu(cpu) {
+		struct lpm_cpu *lpm_cpu = per_cpu(cpu_lpm, cpu);
+		struct lpm_cluster *cluster;
+
+		if (!lpm_cpu || cpu != cpumask_first(&lpm_cpu->related_cpus))
+			continue;
+
+		seq_printf(m, "\ncpus %*pbl\n", cpumask_pr_args(
+				&lpm_cpu->related_cpus));
+		seq_printf(m, "  %-16s %8s %10s %8s %8s %8s %10s\n", "state",
+				"dt_us", "samples", "p50", "p99", "max",
+				"effective");
+
+		for (i = 0; i < lpm_cpu->nlevels; i++) {
+			memset(hist, 0, sizeof(*hist));
+			for_each_cpu(c, &lpm_cpu->related_cpus)
+				lpm_lat_merge(hist,
+					&per_cpu(exit_latency, c).cpu[i]);
+
+			lpm_exit_latency_show_hist(m, lpm_cpu->levels[i].name,
+				lpm_cpu->levels[i].pwr.exit_latency, hist,
+				per_cpu(cpu_pwr_measured, cpu)[i].exit_latency);
+		}
+
+		cluster = lpm_cpu->parent;
+		if (!cluster || cpu != cpumask_first(&cluster->child_cpus))
+			continue;
+
+		seq_printf(m, "\ncluster %s, cpus %*pbl\n", cluster->cluster_name,
+				cpumask_pr_args(&cluster->child_cpus));
+
+		for (i = 0; i < cluster->nlevels; i++) {
+			memset(hist, 0, sizeof(*hist));
+			for_each_cpu(c, &cluster->child_cpus)
+				lpm_lat_merge(hist,
+					&per_cpu(exit_latency, c).cluster[i]);
+
+			lpm_exit_latency_show_hist(m,
+				cluster->levels[i].level_name,
+				cluster->levels[i].pwr.exit_latency, hist,
+				cluster->levels[i].pwr.exit_latency);
+		}
+	}
+
+	kfree(hist);
+	return 0;
+}
+
+static int lpm_exit_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpm_exit_latency_show, NULL);
+}
+
+static const struct file_operations lpm_exit_latency_fops = {
+	.open = lpm_exit_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int lpm_latency_show(struct seq_file *m, void *unused)
+{
+	struct lpm_latency_req *req;
+
+	seq_printf(m, "cluster level cap: %d\n", lpm_latency_cluster_level);
+	seq_printf(m, "cpus: %*pbl\n", cpumask_pr_args(&lpm_latency_cpus));
+	seq_printf(m, "  %-16s %*pbl\n", "sysfs",
+			cpumask_pr_args(&lpm_latency_user_cpus));
+
+	spin_lock_irq(&lpm_latency_lock);
+	list_for_each_entry(req, &lpm_latency_reqs, list)
+		seq_printf(m, "  %-16s %*pbl\n", req->name,
+				cpumask_pr_args(&req->cpus));
+	spin_unlock_irq(&lpm_latency_lock);
+
+	return 0;
+}
+
+static int lpm_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpm_latency_show, NULL);
+}
+
+static const struct file_operations lpm_latency_fops = {
+	.open = lpm_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void lpm_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("lpm_levels", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_file("periodic", 0400, dir, NULL, &lpm_periodic_fops);
+	debugfs_create_file("prewake", 0400, dir, NULL, &lpm_prewake_fops);
+	debugfs_create_file("wakeups", 0400, dir, NULL, &lpm_wakeups_fops);
+	debugfs_create_file("wake_log", 0400, dir, NULL, &lpm_wake_log_fops);
+	debugfs_create_file("exit_latency", 0400, dir, NULL,
+			&lpm_exit_latency_fops);
+	debugfs_create_file("latency_cpus", 0400, dir, NULL, &lpm_latency_fops);
+}
+
 static int lpm_probe(struct platform_device *pdev)
 {
 	int ret;
@@ -1749,6 +2382,13 @@ static int lpm_probe(struct platform_device *pdev)
 		hrtimer_init(cpu_histtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 		cpu_histtimer = &per_cpu(biastimer, cpu);
 		hrtimer_init(cpu_histtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		cpu_histtimer = &per_cpu(prewaketimer, cpu);
+		hrtimer_init(cpu_histtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		lpm_ring_init(&per_cpu(hist, cpu).resi, lpm_history_depth);
+		lpm_ring_init(&per_cpu(cpu_ipi_history, cpu).interval,
+				lpm_history_depth);
+		lpm_periodic_init(&per_cpu(periodic, cpu));
+		lpm_prewake_init(&per_cpu(prewake, cpu));
 	}
 
 	cluster_timer_init(lpm_root_node);
@@ -1781,6 +2421,13 @@ static int lpm_probe(struct platform_device *pdev)
 		goto failed;
 	}
 
+	if (register_trace_irq_handler_entry(lpm_irq_handler_entry, NULL))
+		pr_warn("Failed to register IRQ probe, no periodic prediction\n");
+	if (register_trace_ipi_entry(lpm_ipi_entry, NULL))
+		pr_warn("Failed to register IPI probe\n");
+
+	lpm_debugfs_init();
+
 	return 0;
 failed:
 	free_cluster_node(lpm_root_node);
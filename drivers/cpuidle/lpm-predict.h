@@ -0,0 +1,748 @@
+/* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __LPM_PREDICT_H__
+#define __LPM_PREDICT_H__
+
+/*
+ * Idle prediction helpers that don't depend on the rest of lpm-levels, so
+ * they can also be built in userspace.
+ */
+
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+#include <linux/time64.h>
+#include <linux/types.h>
+
+/* What ended an idle period, reported by the cpu_idle_wake tracepoint */
+enum lpm_wake_source {
+	LPM_WAKE_NONE,
+	LPM_WAKE_IRQ,
+	LPM_WAKE_IPI,
+	LPM_WAKE_TIMER,
+	LPM_WAKE_MAX,
+};
+
+static const char * const lpm_wake_names[] __maybe_unused = {
+	[LPM_WAKE_NONE]		= "none",
+	[LPM_WAKE_IRQ]		= "irq",
+	[LPM_WAKE_IPI]		= "ipi",
+	[LPM_WAKE_TIMER]	= "timer",
+};
+
+/*
+ * Exit latency histogram. Buckets are 4 us wide up to 256 us and 64 us wide
+ * up to 4352 us, with anything longer in the last one.
+ */
+#define LPM_LAT_BUCKETS		128
+#define LPM_LAT_FINE_US		4
+#define LPM_LAT_COARSE_US	64
+#define LPM_LAT_FINE_MAX	256
+
+struct lpm_lat_hist {
+	uint32_t count[LPM_LAT_BUCKETS];
+	uint64_t samples;
+	uint32_t max;
+};
+
+static inline int lpm_lat_bucket(uint32_t us)
+{
+	if (us < LPM_LAT_FINE_MAX)
+		return us / LPM_LAT_FINE_US;
+
+	return min_t(uint32_t, LPM_LAT_FINE_MAX / LPM_LAT_FINE_US +
+			(us - LPM_LAT_FINE_MAX) / LPM_LAT_COARSE_US,
+			LPM_LAT_BUCKETS - 1);
+}
+
+/* Upper bound of a bucket */
+static inline uint32_t lpm_lat_bucket_us(int bucket)
+{
+	int fine = LPM_LAT_FINE_MAX / LPM_LAT_FINE_US;
+
+	if (bucket < fine)
+		return (bucket + 1) * LPM_LAT_FINE_US;
+
+	return LPM_LAT_FINE_MAX + (bucket - fine + 1) * LPM_LAT_COARSE_US;
+}
+
+static inline void lpm_lat_add(struct lpm_lat_hist *h, uint32_t us)
+{
+	h->count[lpm_lat_bucket(us)]++;
+	h->samples++;
+	h->max = max(h->max, us);
+}
+
+static inline void lpm_lat_merge(struct lpm_lat_hist *h,
+		const struct lpm_lat_hist *from)
+{
+	int i;
+
+	for (i = 0; i < LPM_LAT_BUCKETS; i++)
+		h->count[i] += from->count[i];
+	h->samples += from->samples;
+	h->max = max(h->max, from->max);
+}
+
+/* Upper bound of the bucket holding the given percentile, 0 if empty */
+static inline uint32_t lpm_lat_percentile(const struct lpm_lat_hist *h,
+		uint32_t pct)
+{
+	uint64_t want, seen = 0;
+	int i;
+
+	if (!h->samples)
+		return 0;
+
+	want = div_u64(h->samples * pct + 99, 100);
+	for (i = 0; i < LPM_LAT_BUCKETS; i++) {
+		seen += h->count[i];
+		if (seen >= want)
+			return min(lpm_lat_bucket_us(i), h->max);
+	}
+
+	return h->max;
+}
+
+/* Parameters of a CPU level used for selection */
+struct lpm_level_pwr {
+	uint32_t exit_latency;
+	uint32_t min_residency;
+	uint32_t max_residency;
+};
+
+/*
+ * Residency history. A ring of the last samples keeps running sums so the
+ * mean and variance are O(1) to get, and a queue of decreasing samples whose
+ * front is the maximum for outlier rejection. Premature exits are counted
+ * per mode as samples come and go.
+ */
+#define LPM_HISTORY_MAX		32
+#define LPM_HISTORY_MODES	8
+/* Keeps the sum of squares of a full ring within 64 bits */
+#define LPM_HISTORY_CLAMP	(1U << 26)
+
+struct lpm_ring {
+	uint32_t val[LPM_HISTORY_MAX];
+	int8_t mode[LPM_HISTORY_MAX];
+	bool premature[LPM_HISTORY_MAX];
+	uint32_t depth;
+	uint32_t count;
+	/* Sequence number of the next sample, its slot is seq % depth */
+	uint32_t seq;
+
+	uint64_t sum;
+	uint64_t sumsq;
+
+	/* Sequence numbers of non-increasing samples, oldest first */
+	uint32_t maxq[LPM_HISTORY_MAX];
+	uint32_t maxq_head;
+	uint32_t maxq_len;
+
+	uint32_t failed[LPM_HISTORY_MODES];
+	uint64_t failed_sum[LPM_HISTORY_MODES];
+};
+
+static inline void lpm_ring_init(struct lpm_ring *r, uint32_t depth)
+{
+	memset(r, 0, sizeof(*r));
+	r->depth = clamp_t(uint32_t, depth, 2, LPM_HISTORY_MAX);
+}
+
+static inline bool lpm_ring_full(struct lpm_ring *r)
+{
+	return r->count == r->depth;
+}
+
+static inline uint32_t lpm_ring_slot(struct lpm_ring *r, uint32_t seq)
+{
+	return seq % r->depth;
+}
+
+static inline uint32_t lpm_ring_maxq(struct lpm_ring *r, uint32_t i)
+{
+	return r->maxq[(r->maxq_head + i) % LPM_HISTORY_MAX];
+}
+
+/* Queues a sample after dropping the smaller ones it makes irrelevant */
+static inline void lpm_ring_maxq_push(struct lpm_ring *r, uint32_t seq)
+{
+	uint32_t val = r->val[lpm_ring_slot(r, seq)];
+
+	while (r->maxq_len && r->val[lpm_ring_slot(r,
+			lpm_ring_maxq(r, r->maxq_len - 1))] < val)
+		r->maxq_len--;
+
+	r->maxq[(r->maxq_head + r->maxq_len) % LPM_HISTORY_MAX] = seq;
+	r->maxq_len++;
+}
+
+static inline void lpm_ring_account(struct lpm_ring *r, uint32_t slot,
+		int sign)
+{
+	uint64_t val = r->val[slot];
+	int mode = r->mode[slot];
+
+	if (sign > 0) {
+		r->sum += val;
+		r->sumsq += val * val;
+	} else {
+		r->sum -= val;
+		r->sumsq -= val * val;
+	}
+
+	if (!r->premature[slot] || mode < 0 || mode >= LPM_HISTORY_MODES)
+		return;
+
+	r->failed[mode] += sign;
+	if (sign > 0)
+		r->failed_sum[mode] += val;
+	else
+		r->failed_sum[mode] -= val;
+}
+
+static inline void lpm_ring_push(struct lpm_ring *r, uint32_t val, int mode,
+		bool premature)
+{
+	uint32_t slot = lpm_ring_slot(r, r->seq);
+
+	if (lpm_ring_full(r)) {
+		lpm_ring_account(r, slot, -1);
+		/* The oldest sample shares the slot */
+		if (r->maxq_len && lpm_ring_maxq(r, 0) == r->seq - r->depth) {
+			r->maxq_head = (r->maxq_head + 1) % LPM_HISTORY_MAX;
+			r->maxq_len--;
+		}
+	} else {
+		r->count++;
+	}
+
+	r->val[slot] = min(val, LPM_HISTORY_CLAMP);
+	r->mode[slot] = mode;
+	r->premature[slot] = premature;
+	lpm_ring_account(r, slot, 1);
+	lpm_ring_maxq_push(r, r->seq);
+	r->seq++;
+}
+
+/* Adds to the newest sample, e.g. when a prediction timer cut it short */
+static inline void lpm_ring_amend(struct lpm_ring *r, uint32_t add, int mode,
+		bool premature)
+{
+	uint32_t seq = r->seq - 1;
+	uint32_t slot = lpm_ring_slot(r, seq);
+
+	if (!r->count)
+		return;
+
+	lpm_ring_account(r, slot, -1);
+	r->val[slot] = min(r->val[slot] + min(add, LPM_HISTORY_CLAMP),
+			LPM_HISTORY_CLAMP);
+	r->mode[slot] = mode;
+	r->premature[slot] = premature;
+	lpm_ring_account(r, slot, 1);
+
+	/* The newest sample is always last in the queue, and only grew */
+	r->maxq_len--;
+	lpm_ring_maxq_push(r, seq);
+}
+
+static inline uint32_t lpm_ring_newest(struct lpm_ring *r)
+{
+	return r->val[lpm_ring_slot(r, r->seq - 1)];
+}
+
+static inline bool lpm_ring_stable(uint64_t sum, uint64_t sumsq, uint32_t n,
+		uint32_t min_n, uint32_t ref_stddev, uint64_t *avg)
+{
+	uint64_t var, stddev;
+
+	*avg = div64_u64(sum, n);
+	/* Deviations from the truncated average, like summing them one by one */
+	var = div64_u64(sumsq - 2 * *avg * sum + n * *avg * *avg, n);
+	stddev = int_sqrt(var);
+
+	return (*avg > stddev * 6 && n >= min_n) || stddev <= ref_stddev;
+}
+
+/*
+ * Returns the average of the samples if they're close enough, retrying once
+ * without the maximum samples, or 0 if they're too scattered.
+ */
+static inline uint64_t lpm_ring_deviation(struct lpm_ring *r,
+		uint32_t ref_stddev)
+{
+	uint64_t avg, max, sum, sumsq;
+	uint32_t n, nmax = 0;
+
+	if (!r->count)
+		return 0;
+
+	if (lpm_ring_stable(r->sum, r->sumsq, r->count, r->depth - 1,
+			ref_stddev, &avg))
+		return avg;
+
+	max = r->val[lpm_ring_slot(r, lpm_ring_maxq(r, 0))];
+	while (nmax < r->maxq_len &&
+			r->val[lpm_ring_slot(r, lpm_ring_maxq(r, nmax))] == max)
+		nmax++;
+
+	n = r->count - nmax;
+	if (!n)
+		return 0;
+
+	sum = r->sum - nmax * max;
+	sumsq = r->sumsq - nmax * max * max;
+	if (lpm_ring_stable(sum, sumsq, n, r->depth - 1, ref_stddev, &avg))
+		return avg;
+
+	return 0;
+}
+
+/*
+ * Finds the first level with too many premature exits in the history and
+ * restricts it and deeper levels, or returns false if there isn't one.
+ */
+static inline bool lpm_ring_restrict(struct lpm_ring *r,
+		const struct lpm_level_pwr *levels, int nlevels,
+		uint32_t ref_premature_cnt, int *idx_restrict,
+		uint32_t *idx_restrict_time)
+{
+	uint32_t failed;
+	uint64_t total;
+	int i, j;
+
+	for (j = 1; j < min_t(int, nlevels, LPM_HISTORY_MODES); j++) {
+		failed = r->failed[j];
+		if (!failed || failed < ref_premature_cnt)
+			continue;
+
+		*idx_restrict = j;
+		total = div_u64(r->failed_sum[j], failed);
+		for (i = 0; i < j; i++) {
+			if (total < levels[i].max_residency) {
+				*idx_restrict = i + 1;
+				total = levels[i].max_residency;
+				break;
+			}
+		}
+
+		*idx_restrict_time = total;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Periodic interrupt detector. Devices like touch controllers interrupt at a
+ * fixed scan rate (e.g. every 4.17 ms at 240 Hz), which the residency
+ * history can't capture when other wakeups are mixed in. Each CPU tracks the
+ * last few IRQs it handled, learns their period from consecutive arrivals,
+ * and predicts the next arrival once the period has been stable for a few
+ * samples.
+ */
+#define LPM_PERIODIC_SRCS	4
+/* Consistent intervals needed before an IRQ is considered periodic */
+#define LPM_PERIODIC_LOCK	4
+/* Stop predicting after this many periods without an arrival */
+#define LPM_PERIODIC_STALE	4
+/* Missed arrivals that still count as the same period */
+#define LPM_PERIODIC_MAX_SKIP	8
+#define LPM_PERIODIC_MIN_NS	(500 * NSEC_PER_USEC)
+#define LPM_PERIODIC_MAX_NS	(100 * NSEC_PER_MSEC)
+
+struct lpm_periodic_src {
+	int irq;
+	uint64_t last_ns;
+	uint64_t period_ns;
+	uint32_t confidence;
+};
+
+struct lpm_periodic {
+	struct lpm_periodic_src src[LPM_PERIODIC_SRCS];
+
+	/* Arrival expected by the last idle entry, checked when it happens */
+	int expect_irq;
+	uint64_t expect_ns;
+	uint64_t expect_period_ns;
+
+	uint64_t predictions;
+	uint64_t hits;
+	uint64_t early;
+	uint64_t late;
+	uint64_t missed;
+};
+
+static inline void lpm_periodic_init(struct lpm_periodic *p)
+{
+	int i;
+
+	memset(p, 0, sizeof(*p));
+	for (i = 0; i < LPM_PERIODIC_SRCS; i++)
+		p->src[i].irq = -1;
+	p->expect_irq = -1;
+}
+
+/* Tolerance for an interval to match the learned period: 1/8 of it */
+static inline bool lpm_periodic_match(uint64_t interval, uint64_t period)
+{
+	uint64_t diff = interval > period ? interval - period : period - interval;
+
+	return diff <= period / 8;
+}
+
+static inline void lpm_periodic_learn(struct lpm_periodic_src *src,
+		uint64_t now_ns)
+{
+	uint64_t interval = now_ns - src->last_ns;
+	int64_t error;
+	uint64_t k;
+
+	src->last_ns = now_ns;
+
+	if (src->period_ns && lpm_periodic_match(interval, src->period_ns)) {
+		/* Track slow drift of the period */
+		error = (int64_t)(interval - src->period_ns);
+		src->period_ns += error / 8;
+		if (src->confidence < U32_MAX)
+			src->confidence++;
+		return;
+	}
+
+	/* Arrivals handled on other CPUs or lost leave gaps of k periods */
+	if (src->period_ns && src->confidence >= LPM_PERIODIC_LOCK) {
+		k = div64_u64(interval + src->period_ns / 2, src->period_ns);
+		if (k >= 2 && k <= LPM_PERIODIC_MAX_SKIP &&
+				lpm_periodic_match(interval, k * src->period_ns))
+			return;
+	}
+
+	src->period_ns = interval;
+	src->confidence = 0;
+}
+
+static inline void lpm_periodic_check(struct lpm_periodic *p, int irq,
+		uint64_t now_ns, uint64_t tolerance_ns)
+{
+	int64_t error;
+
+	if (p->expect_irq != irq)
+		return;
+
+	error = (int64_t)(now_ns - p->expect_ns);
+	if (error < -(int64_t)tolerance_ns)
+		p->early++;
+	else if (error > (int64_t)tolerance_ns)
+		p->late++;
+	else
+		p->hits++;
+
+	p->expect_irq = -1;
+}
+
+/* Called for every IRQ handled by the CPU */
+static inline void lpm_periodic_irq(struct lpm_periodic *p, int irq,
+		uint64_t now_ns, uint64_t tolerance_ns)
+{
+	struct lpm_periodic_src *src, *victim = &p->src[0];
+	int i;
+
+	lpm_periodic_check(p, irq, now_ns, tolerance_ns);
+
+	for (i = 0; i < LPM_PERIODIC_SRCS; i++) {
+		src = &p->src[i];
+		if (src->irq == irq) {
+			lpm_periodic_learn(src, now_ns);
+			return;
+		}
+
+		if (src->last_ns < victim->last_ns)
+			victim = src;
+	}
+
+	/* Replace the least recently seen IRQ */
+	victim->irq = irq;
+	victim->last_ns = now_ns;
+	victim->period_ns = 0;
+	victim->confidence = 0;
+}
+
+/*
+ * Returns the time until the next expected periodic arrival, or 0 if none
+ * is expected, and records the prediction for misprediction stats.
+ */
+static inline uint64_t lpm_periodic_predict(struct lpm_periodic *p,
+		uint64_t now_ns, int *irq)
+{
+	uint64_t best = 0;
+	int i;
+
+	/* The previous expected arrival never came */
+	if (p->expect_irq >= 0 &&
+			now_ns > p->expect_ns + p->expect_period_ns) {
+		p->missed++;
+		p->expect_irq = -1;
+	}
+
+	for (i = 0; i < LPM_PERIODIC_SRCS; i++) {
+		struct lpm_periodic_src *src = &p->src[i];
+		uint64_t since, next;
+
+		if (src->irq < 0 || src->confidence < LPM_PERIODIC_LOCK ||
+				src->period_ns < LPM_PERIODIC_MIN_NS ||
+				src->period_ns > LPM_PERIODIC_MAX_NS)
+			continue;
+
+		since = now_ns - src->last_ns;
+		if (since > LPM_PERIODIC_STALE * src->period_ns)
+			continue;
+
+		next = src->period_ns - since % src->period_ns;
+		if (!best || next < best) {
+			best = next;
+			*irq = src->irq;
+			p->expect_period_ns = src->period_ns;
+		}
+	}
+
+	return best;
+}
+
+/* Records that idle state selection relied on the given prediction */
+static inline void lpm_periodic_expect(struct lpm_periodic *p, int irq,
+		uint64_t arrival_ns)
+{
+	if (p->expect_irq == irq && p->expect_ns == arrival_ns)
+		return;
+
+	p->predictions++;
+	p->expect_irq = irq;
+	p->expect_ns = arrival_ns;
+}
+
+/*
+ * Pre-wake ahead of an expected periodic arrival. A timer takes the CPU out
+ * of a deep state early enough for it to sit in a shallow one, so the
+ * arrival itself doesn't pay the deep exit latency.
+ */
+struct lpm_prewake {
+	int irq;
+	uint64_t arrival_ns;
+	uint64_t offset_ns;
+	uint64_t fired_ns;
+	bool pending;
+	bool fired;
+	/* The pending timer was cancelled by an idle exit */
+	bool woke;
+
+	uint64_t armed;
+	uint64_t on_time;
+	uint64_t early;
+	uint64_t late;
+	uint64_t lead_ns;
+};
+
+static inline void lpm_prewake_init(struct lpm_prewake *pw)
+{
+	memset(pw, 0, sizeof(*pw));
+	pw->irq = -1;
+}
+
+/*
+ * Returns the delay for the pre-wake timer, or 0 if sleeping until offset_ns
+ * before the arrival is shorter than min_sleep_ns.
+ */
+static inline uint64_t lpm_prewake_arm(struct lpm_prewake *pw, int irq,
+		uint64_t now_ns, uint64_t arrival_ns, uint64_t offset_ns,
+		uint64_t min_sleep_ns)
+{
+	if (arrival_ns < now_ns + offset_ns + min_sleep_ns)
+		return 0;
+
+	/* Re-entering idle before the same arrival doesn't count again */
+	if (pw->irq != irq || pw->arrival_ns != arrival_ns) {
+		pw->armed++;
+		pw->fired = false;
+	}
+
+	pw->irq = irq;
+	pw->arrival_ns = arrival_ns;
+	pw->offset_ns = offset_ns;
+	pw->pending = true;
+	pw->woke = false;
+
+	return arrival_ns - offset_ns - now_ns;
+}
+
+static inline void lpm_prewake_fired(struct lpm_prewake *pw, uint64_t now_ns)
+{
+	pw->pending = false;
+	pw->fired = true;
+	pw->fired_ns = now_ns;
+}
+
+/* Called on idle exit with the timer cancelled if it was pending */
+static inline void lpm_prewake_exit(struct lpm_prewake *pw)
+{
+	if (!pw->pending)
+		return;
+
+	pw->pending = false;
+	pw->woke = true;
+}
+
+/* Called for every IRQ handled by the CPU */
+static inline void lpm_prewake_irq(struct lpm_prewake *pw, int irq,
+		uint64_t now_ns, uint64_t tolerance_ns)
+{
+	bool woke = pw->woke;
+	uint64_t lead;
+
+	pw->woke = false;
+	if (pw->irq < 0 || pw->irq != irq)
+		return;
+
+	if (pw->fired) {
+		lead = now_ns - pw->fired_ns;
+		pw->lead_ns += lead;
+		if (lead > pw->offset_ns + tolerance_ns)
+			pw->early++;
+		else
+			pw->on_time++;
+	} else if (woke) {
+		/* The arrival itself woke the CPU from the deep state */
+		pw->late++;
+	}
+
+	pw->irq = -1;
+	pw->pending = false;
+	pw->fired = false;
+}
+
+struct lpm_select {
+	const struct lpm_level_pwr *levels;
+	int nlevels;
+	uint32_t latency_us;
+	int64_t sleep_us;
+	uint32_t next_event_us;
+	uint32_t periodic_us;
+	uint32_t periodic_guard_us;
+	/* False for isolated CPUs */
+	bool predict;
+
+	/* Whether a level other than the first may be used, NULL for all */
+	bool (*allow)(struct lpm_select *sel, int idx);
+	/* History prediction, also fills in the idx_restrict fields */
+	uint64_t (*predictor)(struct lpm_select *sel);
+	void (*invalidate)(struct lpm_select *sel);
+
+	int best_level;
+	int idx_restrict;
+	uint32_t idx_restrict_time;
+	uint32_t ipi_predicted;
+	uint64_t predicted;
+	uint32_t next_wakeup_us;
+	uint32_t modified_time_us;
+	bool periodic_predicted;
+};
+
+/* Picks the deepest CPU level that the constraints and predictions allow */
+static inline void lpm_select_level(struct lpm_select *sel)
+{
+	const struct lpm_level_pwr *pwr_params;
+	uint32_t lvl_latency_us, min_residency, max_residency;
+	int i;
+
+	sel->best_level = 0;
+	sel->idx_restrict = sel->nlevels + 1;
+	sel->idx_restrict_time = 0;
+	sel->ipi_predicted = 0;
+	sel->predicted = 0;
+	sel->next_wakeup_us = (uint32_t)sel->sleep_us;
+	sel->modified_time_us = 0;
+	sel->periodic_predicted = false;
+
+	for (i = 0; i < sel->nlevels; i++) {
+		if (i && sel->allow && !sel->allow(sel, i))
+			continue;
+
+		pwr_params = &sel->levels[i];
+		lvl_latency_us = pwr_params->exit_latency;
+		min_residency = pwr_params->min_residency;
+		max_residency = pwr_params->max_residency;
+
+		if (sel->latency_us <= lvl_latency_us)
+			break;
+
+		/* Be out of the state before the next periodic IRQ arrives */
+		if (sel->periodic_us && sel->periodic_us <=
+				lvl_latency_us + sel->periodic_guard_us)
+			break;
+
+		if (sel->next_event_us) {
+			if (sel->next_event_us < lvl_latency_us)
+				break;
+
+			if (((sel->next_event_us - lvl_latency_us) <
+					sel->sleep_us) ||
+					(sel->next_event_us < sel->sleep_us))
+				sel->next_wakeup_us = sel->next_event_us -
+						lvl_latency_us;
+		}
+
+		if (!i && sel->predict) {
+			/*
+			 * If the next_wake_us itself is not sufficient for
+			 * deeper low power modes than clock gating do not
+			 * call prediction.
+			 */
+			if (sel->next_wakeup_us > max_residency) {
+				sel->predicted = sel->predictor(sel);
+				if (sel->predicted &&
+						(sel->predicted < min_residency))
+					sel->predicted = min_residency;
+			} else if (sel->invalidate) {
+				sel->invalidate(sel);
+			}
+
+			if (sel->periodic_us &&
+					sel->periodic_us < sel->next_wakeup_us &&
+					(!sel->predicted ||
+					 sel->periodic_us < sel->predicted)) {
+				sel->predicted = max(sel->periodic_us,
+						min_residency);
+				sel->periodic_predicted = true;
+			}
+		}
+
+		if (i >= sel->idx_restrict)
+			break;
+
+		sel->best_level = i;
+
+		if (sel->next_event_us && sel->next_event_us < sel->sleep_us &&
+				!i)
+			sel->modified_time_us = sel->next_event_us -
+					lvl_latency_us;
+		else
+			sel->modified_time_us = 0;
+
+		if (sel->predicted ? (sel->predicted <= max_residency)
+			: (sel->next_wakeup_us <= max_residency))
+			break;
+	}
+}
+
+#endif /* __LPM_PREDICT_H__ */
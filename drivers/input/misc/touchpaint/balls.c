@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Multi-ball bounce mode: a scalable rendering load that needs no touch
+ * input. Balls move in 2D with elastic wall collisions, integrated in 16.16
+ * fixed point using the real time elapsed since the previous frame. Only the
+ * strips each ball exposed or newly covered are redrawn.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/random.h>
+
+#include "draw.h"
+#include "stats.h"
+#include "touchpaint.h"
+
+#define BALLS_MAX 64
+#define BALL_BG_R 64
+#define BALL_BG_G 0
+#define BALL_BG_B 128
+/* Don't let balls jump across the screen after a long stall */
+#define MAX_STEP_NS (50 * NSEC_PER_MSEC)
+
+struct ball {
+	/* Top-left corner in 16.16 fixed point */
+	s64 x;
+	s64 y;
+	/* Pixels per second */
+	int vx;
+	int vy;
+	u32 pixel;
+	struct tp_rect area;
+};
+
+static struct ball balls[BALLS_MAX];
+static int nr_balls;
+static int target_balls;
+static int ball_size;
+static int ball_speed;
+static bool ramp;
+static u64 last_ns;
+static struct rnd_state rnd;
+
+/* Per-step totals while ramping up the ball count */
+static u64 step_start_ns;
+static u64 step_total_ns;
+static u64 step_max_ns;
+static unsigned int step_frames;
+
+/* Every cleared strip of a frame, needed to repair overlapping balls */
+static struct tp_rect exposed[BALLS_MAX * 4];
+
+static DEFINE_TP_STAT(balls_stat, "balls");
+
+static void add_ball(void)
+{
+	static const u32 colors[] = {
+		0xffffeb3b, 0xffe53935, 0xff43a047, 0xff1e88e5,
+		0xffff9800, 0xff00bcd4, 0xffffffff, 0xfff06292,
+	};
+	struct ball *ball = &balls[nr_balls];
+	int speed = max(ball_speed, 1);
+
+	ball->x = (s64)prandom_u32_state(&rnd) % max(fb_width - ball_size, 1) << 16;
+	ball->y = (s64)prandom_u32_state(&rnd) % max(fb_height - ball_size, 1) << 16;
+	ball->vx = speed / 2 + prandom_u32_state(&rnd) % speed;
+	ball->vy = speed / 2 + prandom_u32_state(&rnd) % speed;
+	if (prandom_u32_state(&rnd) & 1)
+		ball->vx = -ball->vx;
+	if (prandom_u32_state(&rnd) & 1)
+		ball->vy = -ball->vy;
+
+	ball->pixel = colors[nr_balls % ARRAY_SIZE(colors)];
+	ball->area = (struct tp_rect){ 0 };
+	nr_balls++;
+}
+
+/* Moves one axis and reflects it off the walls at 0 and limit */
+static void move_axis(s64 *pos, int *vel, s64 limit, u64 delta_ns)
+{
+	*pos += div_s64((s64)*vel * ((s64)delta_ns << 16), NSEC_PER_SEC);
+
+	if (*pos < 0) {
+		*pos = -*pos;
+		*vel = -*vel;
+	} else if (*pos > limit) {
+		*pos = 2 * limit - *pos;
+		*vel = -*vel;
+	}
+
+	*pos = clamp_t(s64, *pos, 0, limit);
+}
+
+static struct tp_rect ball_rect(struct ball *ball)
+{
+	int x = ball->x >> 16, y = ball->y >> 16;
+
+	return (struct tp_rect){ x, y, x + ball_size, y + ball_size };
+}
+
+static void draw_color(const struct tp_rect *rect, u32 pixel)
+{
+	draw_rect(rect, (pixel >> 16) & 0xff, (pixel >> 8) & 0xff, pixel & 0xff);
+}
+
+static void render(void)
+{
+	struct tp_rect area, strips[4], overlap;
+	int nr_exposed = 0;
+	int i, j, nr;
+
+	/* Clear everything that's no longer covered by its ball */
+	for (i = 0; i < nr_balls; i++) {
+		area = ball_rect(&balls[i]);
+		nr_exposed += tp_rect_subtract(exposed + nr_exposed, &balls[i].area,
+					       &area);
+	}
+
+	for (i = 0; i < nr_exposed; i++)
+		draw_rect(&exposed[i], BALL_BG_R, BALL_BG_G, BALL_BG_B);
+
+	/* Draw newly covered strips and repair balls under cleared strips */
+	for (i = 0; i < nr_balls; i++) {
+		struct ball *ball = &balls[i];
+
+		area = ball_rect(ball);
+		nr = tp_rect_subtract(strips, &area, &ball->area);
+		for (j = 0; j < nr; j++) {
+			draw_color(&strips[j], ball->pixel);
+			tp_fb_flush(&strips[j]);
+		}
+
+		for (j = 0; j < nr_exposed; j++) {
+			if (tp_rect_intersect(&overlap, &area, &exposed[j]))
+				draw_color(&overlap, ball->pixel);
+		}
+
+		ball->area = area;
+	}
+
+	for (i = 0; i < nr_exposed; i++)
+		tp_fb_flush(&exposed[i]);
+}
+
+static void ramp_step(u64 now_ns, u64 render_ns)
+{
+	step_total_ns += render_ns;
+	step_max_ns = max(step_max_ns, render_ns);
+	step_frames++;
+
+	if (now_ns - step_start_ns < NSEC_PER_SEC)
+		return;
+
+	pr_info("%2d balls: avg %llu ns, max %llu ns per frame\n", nr_balls,
+		div_u64(step_total_ns, step_frames), step_max_ns);
+
+	step_start_ns = now_ns;
+	step_total_ns = 0;
+	step_max_ns = 0;
+	step_frames = 0;
+
+	if (nr_balls < target_balls)
+		add_ball();
+	else
+		ramp = false;
+}
+
+void tp_balls_frame(u64 now_ns)
+{
+	s64 max_x = (s64)max(fb_width - ball_size, 0) << 16;
+	s64 max_y = (s64)max(fb_height - ball_size, 0) << 16;
+	u64 delta_ns = min_t(u64, now_ns - last_ns, MAX_STEP_NS);
+	u64 start;
+	int i;
+
+	last_ns = now_ns;
+	for (i = 0; i < nr_balls; i++) {
+		move_axis(&balls[i].x, &balls[i].vx, max_x, delta_ns);
+		move_axis(&balls[i].y, &balls[i].vy, max_y, delta_ns);
+	}
+
+	start = ktime_get_ns();
+	render();
+	now_ns = ktime_get_ns();
+	tp_stat_add(&balls_stat, now_ns - start);
+
+	if (ramp)
+		ramp_step(now_ns, now_ns - start);
+}
+
+/*
+ * Starts with count balls, or with one ball and adds another every second
+ * until there are count balls if ramp_up is set.
+ */
+void tp_balls_start(int count, int size, int speed, bool ramp_up)
+{
+	int i;
+
+	target_balls = clamp(count, 1, BALLS_MAX);
+	ball_size = clamp(size, 1, min(fb_width, fb_height));
+	ball_speed = speed;
+	ramp = ramp_up;
+
+	prandom_seed_state(&rnd, 0x746f7563);
+	nr_balls = 0;
+	for (i = 0; i < (ramp ? 1 : target_balls); i++)
+		add_ball();
+
+	fill_screen(BALL_BG_R, BALL_BG_G, BALL_BG_B);
+	render();
+	tp_fb_flush_all();
+
+	last_ns = step_start_ns = ktime_get_ns();
+	step_total_ns = 0;
+	step_max_ns = 0;
+	step_frames = 0;
+}
+
+void tp_balls_init(void)
+{
+	tp_stat_register(&balls_stat);
+}
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Brush stamp cache. Each brush is precomputed as a list of horizontal
+ * spans, so drawing any shape costs exactly one line per row. Stamps are
+ * built on first use and never change afterwards.
+ */
+
+#include <linux/kernel.h>
+#include <asm/barrier.h>
+
+#include "brush.h"
+#include "draw.h"
+
+static struct brush_stamp stamps[BRUSH_SHAPE_MAX][BRUSH_MAX_SIZE + 1];
+static bool stamp_ready[BRUSH_SHAPE_MAX][BRUSH_MAX_SIZE + 1];
+
+/* Same geometry as draw_point() */
+static void build_square(struct brush_stamp *stamp, int size)
+{
+	int radius = max(1, (size - 1) / 2);
+	int i;
+
+	for (i = 0; i < size; i++) {
+		stamp->spans[i].dy = i - radius;
+		stamp->spans[i].x = -radius;
+		stamp->spans[i].len = size;
+	}
+
+	stamp->nr_spans = size;
+}
+
+/*
+ * Covers every pixel whose center lies within the circle inscribed in the
+ * square brush of the same size. In doubled coordinates, pixel (i, j) of the
+ * box is covered if (2j + 1 - size)^2 + (2i + 1 - size)^2 <= size^2.
+ */
+static void build_round(struct brush_stamp *stamp, int size)
+{
+	int radius = max(1, (size - 1) / 2);
+	int i;
+
+	for (i = 0; i < size; i++) {
+		int dy2 = 2 * i + 1 - size;
+		int half = int_sqrt(size * size - dy2 * dy2);
+		int start = DIV_ROUND_UP(size - 1 - half, 2);
+		int end = (size - 1 + half) / 2;
+
+		stamp->spans[i].dy = i - radius;
+		stamp->spans[i].x = start - radius;
+		stamp->spans[i].len = end - start + 1;
+	}
+
+	stamp->nr_spans = size;
+}
+
+const struct brush_stamp *brush_get_stamp(enum brush_shape shape, int size)
+{
+	struct brush_stamp *stamp;
+
+	size = clamp(size, 1, BRUSH_MAX_SIZE);
+	if (shape >= BRUSH_SHAPE_MAX)
+		shape = BRUSH_SQUARE;
+
+	stamp = &stamps[shape][size];
+	if (smp_load_acquire(&stamp_ready[shape][size]))
+		return stamp;
+
+	/* Concurrent builders produce identical stamps, so no lock is needed */
+	if (shape == BRUSH_ROUND)
+		build_round(stamp, size);
+	else
+		build_square(stamp, size);
+
+	smp_store_release(&stamp_ready[shape][size], true);
+	return stamp;
+}
+
+void draw_stamp(int x, int y, const struct brush_stamp *stamp,
+		u8 r, u8 g, u8 b)
+{
+	const struct brush_span *span = stamp->spans;
+	const struct brush_span *end = span + stamp->nr_spans;
+
+	for (; span < end; span++)
+		draw_h_line(x + span->x, y + span->dy, span->len, r, g, b);
+}
+
+/* Bresenham's line drawing algorithm, see draw_line() */
+void draw_stamp_line(int x1, int y1, int x2, int y2,
+		     const struct brush_stamp *stamp, u8 r, u8 g, u8 b)
+{
+	int dx = abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+	int dy = abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+	int err = (dx > dy ? dx : -dy) / 2;
+	int err2;
+	int x = x1, y = y1;
+
+	while (true) {
+		draw_stamp(x, y, stamp, r, g, b);
+
+		if (x == x2 && y == y2)
+			break;
+
+		err2 = err;
+		if (err2 > -dx) {
+			err -= dy;
+			x += sx;
+		}
+
+		if (err2 < dy) {
+			err += dx;
+			y += sy;
+		}
+	}
+}
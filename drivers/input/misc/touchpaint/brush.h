@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ */
+
+#ifndef _TOUCHPAINT_BRUSH_H
+#define _TOUCHPAINT_BRUSH_H
+
+#include <linux/types.h>
+
+#define BRUSH_MAX_SIZE 64
+
+enum brush_shape {
+	BRUSH_SQUARE,
+	BRUSH_ROUND,
+	BRUSH_SHAPE_MAX
+};
+
+/* One row of a brush, relative to the brush position */
+struct brush_span {
+	s16 dy;
+	s16 x;
+	u16 len;
+};
+
+struct brush_stamp {
+	int nr_spans;
+	struct brush_span spans[BRUSH_MAX_SIZE];
+};
+
+const struct brush_stamp *brush_get_stamp(enum brush_shape shape, int size);
+void draw_stamp(int x, int y, const struct brush_stamp *stamp,
+		u8 r, u8 g, u8 b);
+void draw_stamp_line(int x1, int y1, int x2, int y2,
+		     const struct brush_stamp *stamp, u8 r, u8 g, u8 b);
+
+#endif /* _TOUCHPAINT_BRUSH_H */
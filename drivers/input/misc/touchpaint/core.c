@@ -0,0 +1,815 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/input.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/version.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 10, 0)
+#include <uapi/linux/sched/types.h>
+#endif
+
+#include "brush.h"
+#include "draw.h"
+#include "paint.h"
+#include "sprite.h"
+#include "stats.h"
+#include "timer.h"
+#include "touchpaint.h"
+
+#define MAX_FINGERS 10
+#define BOUNCE_BOX_SIZE 301
+#define FILL_BLANK_DELAY_MS 250
+
+/* Used when neither module parameters nor the device tree describe the framebuffer */
+#define DEFAULT_FB_PHYS_ADDR 0x9c000000
+#define DEFAULT_FB_MAX_SIZE 0x02400000
+#define DEFAULT_FB_WIDTH 1080
+#define DEFAULT_FB_HEIGHT 2340
+
+struct point {
+	int x;
+	int y;
+};
+
+enum tp_mode {
+	MODE_PAINT,
+	MODE_FILL,
+	MODE_BOUNCE,
+	MODE_FOLLOW,
+	MODE_SCROLL,
+	MODE_BALLS,
+	MODE_TEAR,
+	MODE_MAX
+};
+
+/* Config */
+/* Framebuffer parameters left at 0 are read from the device tree */
+static phys_addr_t fb_phys_addr;
+module_param(fb_phys_addr, ullong, 0444);
+static size_t fb_max_size;
+module_param(fb_max_size, ulong, 0444);
+/* Framebuffer memory type: 0 = write-combining, 1 = write-through, 2 = write-back */
+static int fb_map = FB_MAP_WC;
+module_param(fb_map, int, 0444);
+/* Map the framebuffer with 2 MiB/1 GiB blocks where possible */
+static bool fb_blocks = true;
+module_param(fb_blocks, bool, 0444);
+int fb_width;
+module_param(fb_width, int, 0444);
+int fb_height;
+module_param(fb_height, int, 0444);
+/* Bytes per row, defaults to the width */
+static int fb_pitch;
+module_param(fb_pitch, int, 0444);
+/* Only simple-framebuffer's a8r8g8b8 and x8r8g8b8 are supported */
+static char *fb_format;
+module_param(fb_format, charp, 0444);
+static enum tp_mode mode = MODE_PAINT;
+module_param(mode, int, 0644);
+/* Brush size in pixels - odd = slower but centered, even = faster but not centered */
+static int brush_size = 2;
+/* 0 = square, 1 = round */
+static int brush_shape = BRUSH_SQUARE;
+/* Brush size source: 0 = brush_size, 1 = ABS_MT_PRESSURE, 2 = ABS_MT_TOUCH_MAJOR */
+static int brush_pressure;
+module_param(brush_pressure, int, 0644);
+/* Brush size at the maximum pressure or touch size */
+static int brush_max_size = 32;
+module_param(brush_max_size, int, 0644);
+/* Per-finger brush sizes, 0 = brush_size */
+static int slot_brush_sizes[MAX_FINGERS];
+module_param_array(slot_brush_sizes, int, NULL, 0644);
+/* Per-finger paint colors in ARGB_8888 */
+static unsigned int slot_colors[MAX_FINGERS] = {
+	0xffffffff, 0xffe53935, 0xff43a047, 0xff1e88e5, 0xfffdd835,
+	0xff8e24aa, 0xfffb8c00, 0xff00acc1, 0xffd81b60, 0xffc0ca33,
+};
+module_param_array(slot_colors, uint, NULL, 0644);
+/* Render each finger's strokes on a per-CPU worker instead of inline */
+static bool paint_parallel;
+module_param(paint_parallel, bool, 0644);
+/* Batch strokes and render them right before the next vblank */
+static bool paint_vsync;
+module_param(paint_vsync, bool, 0644);
+/* Display refresh rate for vsync pacing */
+unsigned int tp_vsync_hz = 60;
+module_param_named(vsync_hz, tp_vsync_hz, uint, 0644);
+/* Offset of vblanks from multiples of the refresh period */
+int tp_vsync_phase_us;
+module_param_named(vsync_phase_us, tp_vsync_phase_us, int, 0644);
+/* Time before vblank to start rendering a frame */
+unsigned int tp_vsync_budget_us = 2000;
+module_param_named(vsync_budget_us, tp_vsync_budget_us, uint, 0644);
+/* Use SCHED_DEADLINE rather than SCHED_FIFO for vsync-paced render threads */
+bool tp_render_deadline;
+module_param_named(render_deadline, tp_render_deadline, bool, 0644);
+static int follow_box_size = 301;
+module_param(follow_box_size, int, 0644);
+/* Paint clear delay in ms. 0 = on next touch, -1 = never */
+static int paint_clear_delay = 0;
+module_param(paint_clear_delay, int, 0644);
+/* Number of balls in balls mode, up to 64 */
+static int balls = 16;
+module_param(balls, int, 0644);
+static int ball_size = 64;
+module_param(ball_size, int, 0644);
+/* Average ball speed in pixels per second */
+static int ball_speed = 800;
+module_param(ball_speed, int, 0644);
+/* Start with one ball and add one per second, logging the render cost */
+static bool balls_ramp;
+module_param(balls_ramp, bool, 0644);
+/* Show render latency, touch sample rate, and mode at the top of the screen */
+static bool hud;
+module_param(hud, bool, 0644);
+/* Idle exit latency limit for touch and render CPUs while touching, -1 = off */
+int tp_idle_latency_us = 100;
+module_param_named(idle_latency_us, tp_idle_latency_us, int, 0644);
+/* How long to keep the limit and frequency floor after the last finger up */
+int tp_idle_hold_ms = 500;
+module_param_named(idle_hold_ms, tp_idle_hold_ms, int, 0644);
+/* Also keep the clusters of those CPUs out of deep cluster idle modes */
+bool tp_idle_cluster_hold = true;
+module_param_named(idle_cluster_hold, tp_idle_cluster_hold, bool, 0644);
+/* Minimum frequency of touch and render CPUs while touching, in % of max */
+int tp_freq_floor_pct = 60;
+module_param_named(freq_floor_pct, tp_freq_floor_pct, int, 0644);
+
+/* Build the stamp now so the first stroke doesn't pay for it */
+static int brush_param_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_int(val, kp);
+
+	if (ret)
+		return ret;
+
+	brush_get_stamp(brush_shape, brush_size);
+	return 0;
+}
+
+static const struct kernel_param_ops brush_param_ops = {
+	.set = brush_param_set,
+	.get = param_get_int,
+};
+module_param_cb(brush_size, &brush_param_ops, &brush_size, 0644);
+module_param_cb(brush_shape, &brush_param_ops, &brush_shape, 0644);
+
+static const char * const mode_names[MODE_MAX] = {
+	[MODE_PAINT] = "PAINT",
+	[MODE_FILL] = "FILL",
+	[MODE_BOUNCE] = "BOUNCE",
+	[MODE_FOLLOW] = "FOLLOW",
+	[MODE_SCROLL] = "SCROLL",
+	[MODE_BALLS] = "BALLS",
+	[MODE_TEAR] = "TEAR",
+};
+
+/* State */
+u32 __iomem *fb_mem;
+int fb_stride;
+static size_t fb_size;
+static bool init_done;
+static unsigned int fingers;
+static struct point slots[MAX_FINGERS];
+static bool finger_down[MAX_FINGERS];
+static struct point last_point[MAX_FINGERS];
+/* Brush size derived from pressure or touch size, 0 if not reported */
+static int slot_brush_size[MAX_FINGERS];
+static struct tp_sprite follow_sprites[MAX_FINGERS];
+static struct task_struct *anim_thread;
+static int scroll_slot;
+static u64 frame_start_ns;
+static bool frame_rendered;
+static u64 last_frame_ns;
+/* Moving average of the interval between touch frames */
+static u64 frame_interval_ns;
+
+/* Stats */
+static DEFINE_TP_STAT(render_stat, "render");
+
+/* Called after the whole screen was redrawn */
+static void invalidate_screen(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_FINGERS; i++)
+		tp_sprite_reset(&follow_sprites[i]);
+
+	tp_hud_invalidate();
+}
+
+static void blank_screen(void)
+{
+	memset_io(fb_mem, 0, fb_size);
+	tp_fb_flush_all();
+	invalidate_screen();
+}
+
+static void blank_callback(struct tp_timer *timer)
+{
+	blank_screen();
+}
+static struct tp_timer blank_timer;
+
+static void fill_screen_white(void)
+{
+	memset_io(fb_mem, 0xff, fb_size);
+	tp_fb_flush_all();
+	invalidate_screen();
+}
+
+static void update_sample_rate(u64 now_ns)
+{
+	u64 interval = now_ns - last_frame_ns;
+
+	/* Only count consecutive frames within the same touch */
+	if (fingers && last_frame_ns && interval < NSEC_PER_SEC) {
+		if (frame_interval_ns)
+			frame_interval_ns = (frame_interval_ns * 7 + interval) / 8;
+		else
+			frame_interval_ns = interval;
+	}
+
+	last_frame_ns = fingers ? now_ns : 0;
+}
+
+static unsigned int sample_rate_hz(void)
+{
+	if (!frame_interval_ns)
+		return 0;
+
+	return div64_u64(NSEC_PER_SEC + frame_interval_ns / 2, frame_interval_ns);
+}
+
+static int box_y;
+static int box_step;
+
+static void box_start(void)
+{
+	box_y = fb_height / 12;
+	box_step = 7;
+
+	fill_screen(64, 0, 128);
+	draw_point(fb_width / 2, box_y, BOUNCE_BOX_SIZE, 255, 255, 0);
+	tp_fb_flush_all();
+}
+
+static void box_frame(u64 now_ns)
+{
+	int radius = (BOUNCE_BOX_SIZE - 1) / 2;
+	struct tp_rect dirty;
+
+	if (box_y > fb_height - (fb_height / 12) || box_y < fb_height / 12)
+		box_step *= -1;
+
+	/* Draw damage rather than redrawing the entire box */
+	draw_vert_point_damage(BOUNCE_BOX_SIZE, fb_width / 2, box_y,
+			       box_y + box_step, 255, 255, 0, 64, 0, 128);
+
+	dirty.x1 = fb_width / 2 - radius;
+	dirty.x2 = dirty.x1 + BOUNCE_BOX_SIZE;
+	dirty.y1 = min(box_y, box_y + box_step) - radius;
+	dirty.y2 = max(box_y, box_y + box_step) - radius + BOUNCE_BOX_SIZE;
+	tp_fb_flush(&dirty);
+
+	box_y += box_step;
+}
+
+static void balls_start(void)
+{
+	tp_balls_start(balls, ball_size, ball_speed, balls_ramp);
+}
+
+/* Modes that render on their own rather than in response to touches */
+static const struct tp_anim {
+	void (*start)(void);
+	void (*frame)(u64 now_ns);
+} anims[MODE_MAX] = {
+	[MODE_BOUNCE] = { box_start, box_frame },
+	[MODE_BALLS] = { balls_start, tp_balls_frame },
+};
+
+static int anim_thread_func(void *data)
+{
+	const struct tp_anim *anim = data;
+	struct tp_sched sched;
+
+	tp_sched_setup(&sched);
+
+	tp_vsync_get();
+	anim->start();
+	while (!kthread_should_stop()) {
+		u64 vblank_ns = tp_vsync_wait();
+		u64 start = ktime_get_ns();
+
+		anim->frame(vblank_ns);
+		tp_hold_note_cpu();
+		tp_sched_frame(&sched, ktime_get_ns() - start);
+		tp_vsync_frame_done(vblank_ns);
+	}
+	tp_vsync_put();
+
+	return 0;
+}
+
+static void __start_anim_thread(struct tp_timer *timer)
+{
+	if (anim_thread || mode >= MODE_MAX || !anims[mode].frame)
+		return;
+
+	anim_thread = kthread_run(anim_thread_func, (void *)&anims[mode],
+				  "touchpaint_anim");
+	if (IS_ERR(anim_thread)) {
+		pr_err("failed to start animation thread! err=%d\n",
+		       PTR_ERR(anim_thread));
+		anim_thread = NULL;
+	}
+}
+static struct tp_timer start_anim_timer;
+
+static void __stop_anim_thread(struct tp_timer *timer)
+{
+	int ret;
+
+	if (!anim_thread)
+		return;
+
+	ret = kthread_stop(anim_thread);
+	if (ret) {
+		pr_err("failed to stop animation thread! err=%d\n", ret);
+		return;
+	}
+
+	anim_thread = NULL;
+	blank_screen();
+}
+static struct tp_timer stop_anim_timer;
+
+static void start_anim_thread(void)
+{
+	tp_timer_start(&start_anim_timer, 0);
+}
+
+static void stop_anim_thread(void)
+{
+	tp_timer_start(&stop_anim_timer, 0);
+}
+
+static void touchpaint_finger_down(int slot)
+{
+	if (!init_done || finger_down[slot])
+		return;
+
+	pr_debug("finger %d down\n", slot);
+	finger_down[slot] = true;
+
+	if (mode == MODE_FOLLOW)
+		tp_sprite_resize(&follow_sprites[slot], follow_box_size,
+				 follow_box_size);
+
+	if (++fingers == 1) {
+		tp_hold_touch_down();
+
+		switch (mode) {
+		case MODE_PAINT:
+			if (paint_clear_delay > 0)
+				tp_timer_cancel(&blank_timer);
+			else if (paint_clear_delay == 0)
+				blank_screen();
+
+			break;
+		case MODE_FILL:
+			tp_timer_cancel(&blank_timer);
+			fill_screen_white();
+			break;
+		case MODE_BOUNCE:
+		case MODE_BALLS:
+			if (anim_thread)
+				stop_anim_thread();
+			else
+				start_anim_thread();
+
+			break;
+		case MODE_SCROLL:
+			scroll_slot = slot;
+			tp_scroll_touch_down(slots[slot].y);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void touchpaint_finger_up(int slot)
+{
+	if (!init_done || !finger_down[slot])
+		return;
+
+	pr_debug("finger %d up\n", slot);
+
+	if (--fingers == 0) {
+		tp_hold_touch_up();
+
+		if (mode == MODE_FILL)
+			tp_timer_start(&blank_timer,
+				       FILL_BLANK_DELAY_MS * NSEC_PER_MSEC);
+		else if (mode == MODE_PAINT && paint_clear_delay > 0)
+			tp_timer_start(&blank_timer,
+				       (u64)paint_clear_delay * NSEC_PER_MSEC);
+	}
+
+	if (mode == MODE_FOLLOW)
+		tp_sprite_hide(&follow_sprites[slot]);
+
+	finger_down[slot] = false;
+	slot_brush_size[slot] = 0;
+	last_point[slot].x = 0;
+	last_point[slot].y = 0;
+}
+
+static const struct brush_stamp *slot_brush(int slot)
+{
+	int size = slot_brush_sizes[slot] ?: brush_size;
+
+	if (brush_pressure && slot_brush_size[slot])
+		size = slot_brush_size[slot];
+
+	return brush_get_stamp(brush_shape, size);
+}
+
+static enum tp_paint_render paint_render(void)
+{
+	if (paint_vsync)
+		return PAINT_VSYNC;
+
+	return paint_parallel ? PAINT_PARALLEL : PAINT_INLINE;
+}
+
+static void touchpaint_finger_point(int slot, int x, int y)
+{
+	struct tp_segment seg = {
+		.x1 = x,
+		.y1 = y,
+		.x2 = x,
+		.y2 = y,
+	};
+
+	if (!init_done || !finger_down[slot] || READ_ONCE(tp_fb_bench_running))
+		return;
+
+	switch (mode) {
+	case MODE_PAINT:
+		frame_rendered = true;
+
+		if (last_point[slot].x && last_point[slot].y) {
+			seg.x1 = last_point[slot].x;
+			seg.y1 = last_point[slot].y;
+		}
+
+		seg.stamp = slot_brush(slot);
+		seg.color = slot_colors[slot];
+		tp_paint_segment(slot, &seg, frame_start_ns, paint_render());
+		break;
+	case MODE_FOLLOW:
+		frame_rendered = true;
+		tp_sprite_move(&follow_sprites[slot], x, y);
+		break;
+	case MODE_SCROLL:
+		if (slot != scroll_slot)
+			break;
+
+		frame_rendered = true;
+		tp_scroll_touch_move(y);
+		break;
+	case MODE_TEAR:
+		frame_rendered = true;
+		tp_tear_render(x);
+		break;
+	default:
+		break;
+	}
+
+	last_point[slot].x = x;
+	last_point[slot].y = y;
+}
+
+/* Scales a pressure or touch size value to a brush size */
+static int pressure_to_brush_size(struct input_dev *dev, unsigned int code,
+				  int value)
+{
+	int max = input_abs_get_max(dev, code);
+
+	if (max <= 0)
+		return 0;
+
+	return DIV_ROUND_UP(clamp(value, 0, max) * brush_max_size, max);
+}
+
+static void hud_callback(struct tp_timer *timer)
+{
+	enum tp_mode cur_mode = READ_ONCE(mode);
+
+	if (hud && cur_mode < MODE_MAX)
+		tp_hud_update(&render_stat, sample_rate_hz(), mode_names[cur_mode]);
+}
+static struct tp_timer hud_timer;
+
+static void touchpaint_input_event(struct input_handle *handle,
+				   unsigned int type, unsigned int code, int value)
+{
+	static int slot = 0;
+
+	pr_debug("input event: type=%u code=%u val=%d\n", type, code, value);
+
+	/* Input events are delivered in batches, so this marks the frame start */
+	if (!frame_start_ns)
+		frame_start_ns = ktime_get_ns();
+
+	if (type == EV_KEY && code == KEY_VOLUMEUP && value == 1) {
+		/* Animations need to be stopped before cycling to prevent artifacts */
+		if (mode < MODE_MAX && anims[mode].frame)
+			stop_anim_thread();
+
+		/* Cycle mode */
+		if (++mode == MODE_MAX)
+			mode = 0;
+
+		blank_screen();
+		tp_scroll_reset();
+	} else if (type == EV_ABS) {
+		switch (code) {
+		case ABS_MT_SLOT:
+			slot = value;
+			break;
+		case ABS_MT_POSITION_X:
+			slots[slot].x = value;
+			break;
+		case ABS_MT_POSITION_Y:
+			slots[slot].y = value;
+			break;
+		case ABS_MT_PRESSURE:
+			if (brush_pressure == 1)
+				slot_brush_size[slot] =
+					pressure_to_brush_size(handle->dev, code, value);
+			break;
+		case ABS_MT_TOUCH_MAJOR:
+			if (brush_pressure == 2)
+				slot_brush_size[slot] =
+					pressure_to_brush_size(handle->dev, code, value);
+			break;
+		case ABS_MT_TRACKING_ID:
+			if (value == -1) {
+				touchpaint_finger_up(slot);
+				slots[slot].x = -1;
+				slots[slot].y = -1;
+			}
+
+			break;
+		default:
+			break;
+		}
+	}
+
+	if ((type == EV_ABS && code == ABS_MT_SLOT) ||
+	    (type == EV_SYN && code == SYN_REPORT)) {
+		if (slots[slot].x != -1 && slots[slot].y != -1) {
+			touchpaint_finger_down(slot);
+			touchpaint_finger_point(slot, slots[slot].x, slots[slot].y);
+		}
+	}
+
+	if (type == EV_SYN && code == SYN_REPORT) {
+		u64 now = ktime_get_ns();
+
+		if (fingers)
+			tp_hold_note_cpu();
+
+		if (mode == MODE_PAINT && paint_render() != PAINT_INLINE)
+			tp_paint_commit(paint_render());
+
+		if (frame_rendered) {
+			tp_stat_add(&render_stat, now - frame_start_ns);
+			tp_freq_add_render(now - frame_start_ns);
+		}
+
+		update_sample_rate(now);
+
+		/* Scrolling and tearing modes redraw the HUD's area */
+		if ((mode == MODE_SCROLL || mode == MODE_TEAR) && frame_rendered)
+			tp_hud_invalidate();
+
+		/* Coalesces HUD updates if the worker falls behind */
+		if (hud && !tp_timer_pending(&hud_timer))
+			tp_timer_start(&hud_timer, 0);
+
+		frame_start_ns = 0;
+		frame_rendered = false;
+	}
+}
+
+static int touchpaint_input_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int ret;
+
+	handle = kzalloc(sizeof(*handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = KBUILD_MODNAME;
+
+	ret = input_register_handle(handle);
+	if (ret)
+		goto err2;
+
+	ret = input_open_device(handle);
+	if (ret)
+		goto err1;
+
+	return 0;
+err1:
+	input_unregister_handle(handle);
+err2:
+	kfree(handle);
+	return ret;
+}
+
+static void touchpaint_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id touchpaint_ids[] = {
+	/* Volume-up key */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT | INPUT_DEVICE_ID_MATCH_KEYBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+		.keybit = { [BIT_WORD(KEY_VOLUMEUP)] = BIT_MASK(KEY_VOLUMEUP) },
+	},
+	/* Touchscreen */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			BIT_MASK(ABS_MT_POSITION_X) |
+			BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	{ }
+};
+
+static struct input_handler touchpaint_input_handler = {
+	.event          = touchpaint_input_event,
+	.connect        = touchpaint_input_connect,
+	.disconnect     = touchpaint_input_disconnect,
+	.name           = KBUILD_MODNAME,
+	.id_table       = touchpaint_ids,
+};
+
+/* Module parameters take precedence over the device tree */
+static int __init setup_fb_info(void)
+{
+	struct tp_fb_info info = { 0 };
+
+	tp_fb_info_from_dt(&info);
+	info.base = fb_phys_addr ?: info.base ?: DEFAULT_FB_PHYS_ADDR;
+	info.size = fb_max_size ?: info.size ?: DEFAULT_FB_MAX_SIZE;
+	info.width = fb_width ?: info.width ?: DEFAULT_FB_WIDTH;
+	info.height = fb_height ?: info.height ?: DEFAULT_FB_HEIGHT;
+	info.pitch = fb_pitch ?: info.pitch ?: info.width * 4;
+	info.format = fb_format ?: info.format ?: "a8r8g8b8";
+
+	if (strcmp(info.format, "a8r8g8b8") && strcmp(info.format, "x8r8g8b8")) {
+		pr_err("unsupported framebuffer format %s!\n", info.format);
+		return -EINVAL;
+	}
+
+	if (info.width <= 0 || info.height <= 0 || info.pitch % 4 ||
+	    info.pitch < info.width * 4 ||
+	    (size_t)info.pitch * info.height > info.size) {
+		pr_err("invalid %dx%d framebuffer with %d-byte rows in %zu bytes!\n",
+		       info.width, info.height, info.pitch, info.size);
+		return -EINVAL;
+	}
+
+	fb_phys_addr = info.base;
+	fb_max_size = info.size;
+	fb_width = info.width;
+	fb_height = info.height;
+	fb_pitch = info.pitch;
+	fb_stride = info.pitch / 4;
+	return 0;
+}
+
+static int __init touchpaint_init(void)
+{
+	int ret;
+	int i;
+
+	ret = touchpaint_selftest();
+	if (ret)
+		pr_err("rendering self-test failed! err=%d\n", ret);
+
+	ret = setup_fb_info();
+	if (ret)
+		return ret;
+
+	ret = tp_fb_map(fb_phys_addr, fb_max_size, fb_map, fb_blocks);
+	if (ret) {
+		pr_err("failed to map %zu-byte framebuffer at %pa!\n", fb_max_size,
+		       &fb_phys_addr);
+		return ret;
+	}
+
+	fb_size = min((size_t)fb_pitch * fb_height, fb_max_size);
+
+	pr_info("using %dx%d framebuffer with %d-byte rows spanning %zu bytes at %pa (mapped to %px)\n",
+		fb_width, fb_height, fb_pitch, fb_size, &fb_phys_addr, fb_mem);
+	blank_screen();
+
+	for (i = 0; i < MAX_FINGERS; i++) {
+		slots[i].x = -1;
+		slots[i].y = -1;
+	}
+
+	/* Boxes can shrink at runtime, but not grow beyond the initial size */
+	for (i = 0; i < MAX_FINGERS; i++) {
+		ret = tp_sprite_init(&follow_sprites[i], follow_box_size,
+				     follow_box_size, 255, 255, 255);
+		if (ret) {
+			pr_warn("failed to allocate follow box! err=%d\n", ret);
+			break;
+		}
+	}
+
+	ret = tp_scroll_init();
+	if (ret)
+		pr_warn("failed to allocate scroll buffer! err=%d\n", ret);
+
+	ret = tp_timers_init();
+	if (ret) {
+		pr_err("failed to create timer worker! err=%d\n", ret);
+		goto err_free;
+	}
+
+	tp_timer_init(&blank_timer, blank_callback);
+	tp_timer_init(&start_anim_timer, __start_anim_thread);
+	tp_timer_init(&stop_anim_timer, __stop_anim_thread);
+	tp_timer_init(&hud_timer, hud_callback);
+	tp_hold_init();
+	tp_freq_init();
+
+	tp_vsync_init();
+	tp_sched_init();
+	ret = tp_paint_init();
+	if (ret)
+		pr_warn("failed to create paint workers! err=%d\n", ret);
+
+	ret = tp_tear_init();
+	if (ret)
+		pr_warn("failed to allocate tearing buffer! err=%d\n", ret);
+
+	tp_stat_register(&render_stat);
+	tp_balls_init();
+	tp_hud_init();
+	ret = tp_stats_init();
+	if (ret)
+		pr_warn("failed to create debugfs stats! err=%d\n", ret);
+
+	/* These skip themselves if debugfs is unavailable */
+	tp_fb_bench_init();
+	tp_qos_debugfs_init();
+	tp_freq_debugfs_init();
+
+	ret = input_register_handler(&touchpaint_input_handler);
+	if (ret)
+		pr_err("failed to register input handler! err=%d\n", ret);
+
+	init_done = 1;
+	return 0;
+
+err_free:
+	tp_scroll_free();
+	for (i = 0; i < MAX_FINGERS; i++)
+		tp_sprite_free(&follow_sprites[i]);
+	tp_fb_unmap();
+	return ret;
+}
+late_initcall_sync(touchpaint_init);
@@ -0,0 +1,219 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+
+#include "draw.h"
+
+static size_t point_to_offset(int x, int y)
+{
+	return x + ((size_t)y * fb_stride);
+}
+
+static u32 rgb_to_pixel(u8 r, u8 g, u8 b)
+{
+	u32 pixel = 0xff000000;
+	pixel |= r << 16;
+	pixel |= g << 8;
+	pixel |= b;
+
+	return pixel;
+}
+
+static void set_pixel(size_t offset_px, u32 pixel)
+{
+	*(volatile u32 *)(fb_mem + offset_px) = pixel;
+}
+
+static void set_2pixels(size_t offset_px, u32 pixel)
+{
+	u64 pixels = ((u64)pixel << 32) | pixel;
+	*(volatile u64 *)(fb_mem + offset_px) = pixels;
+}
+
+#if defined(CONFIG_ARCH_SUPPORTS_INT128) && defined(__SIZEOF_INT128__)
+static void set_4pixels(size_t offset_px, u32 pixel32)
+{
+	unsigned __int128 pixel128 = (unsigned __int128)pixel32;
+	unsigned __int128 pixels = (pixel128 << 96) | (pixel128 << 64) |
+		(pixel128 << 32) | pixel128;
+
+	*(volatile unsigned __int128 *)(fb_mem + offset_px) = pixels;
+}
+#endif
+
+int draw_pixels(int x, int y, int count, u8 r, u8 g, u8 b)
+{
+	size_t offset_px = point_to_offset(x, y);
+	u32 pixel = rgb_to_pixel(r, g, b);
+
+	pr_debug("draw pixels: x=%d y=%d offset=%zupx count=%d color=(%d, %d, %d)\n",
+		 x, y, offset_px, count, r, g, b);
+
+#if defined(CONFIG_ARCH_SUPPORTS_INT128) && defined(__SIZEOF_INT128__)
+	if (count >= 4) {
+		set_4pixels(offset_px, pixel);
+		return 4;
+	}
+#endif
+
+	if (count >= 2) {
+		set_2pixels(offset_px, pixel);
+		return 2;
+	}
+
+	if (count >= 1) {
+		set_pixel(offset_px, pixel);
+		return 1;
+	}
+
+	return 0;
+}
+
+void draw_h_line(int x, int y, int length, u8 r, u8 g, u8 b)
+{
+	int target_x = min(x + length, fb_width);
+	int cur_x = max(x, 0);
+
+	pr_debug("draw horizontal line: x=%d y=%d length=%d r=%d g=%d b=%d\n",
+		 x, y, length, r, g, b);
+	if (y < 0 || y >= fb_height)
+		return;
+
+	while (cur_x < target_x) {
+		int remaining_px = target_x - cur_x;
+		cur_x += draw_pixels(cur_x, y, remaining_px, r, g, b);
+	}
+}
+
+void draw_point(int x, int y, int size, u8 r, u8 g, u8 b)
+{
+	int radius = max(1, (size - 1) / 2);
+	int base_y = max(y - radius, 0);
+	int target_y = min(y - radius + size, fb_height);
+	int cur_y;
+
+	pr_debug("draw point: x=%d y=%d size=%d r=%d g=%d b=%d\n", x, y, size, r, g, b);
+	for (cur_y = base_y; cur_y < target_y; cur_y++) {
+		draw_h_line(x - radius, cur_y, size, r, g, b);
+	}
+}
+
+/*
+ * Bresenham's line drawing algorithm
+ * Source: https://rosettacode.org/wiki/Bitmap/Bresenham%27s_line_algorithm#C
+ */
+void draw_line(int x1, int y1, int x2, int y2, int size, u8 r, u8 g, u8 b)
+{
+	int dx = abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+	int dy = abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+	int err = (dx > dy ? dx : -dy) / 2;
+	int err2;
+	int x = x1, y = y1;
+
+	while (true) {
+		draw_point(x, y, size, r, g, b);
+
+		if (x == x2 && y == y2)
+			break;
+
+		err2 = err;
+		if (err2 > -dx) {
+			err -= dy;
+			x += sx;
+		}
+
+		if (err2 < dy) {
+			err += dx;
+			y += sy;
+		}
+	}
+}
+
+void draw_rect(const struct tp_rect *rect, u8 r, u8 g, u8 b)
+{
+	int y;
+
+	for (y = rect->y1; y < rect->y2; y++)
+		draw_h_line(rect->x1, y, rect->x2 - rect->x1, r, g, b);
+}
+
+bool tp_rect_intersect(struct tp_rect *out, const struct tp_rect *a,
+		       const struct tp_rect *b)
+{
+	out->x1 = max(a->x1, b->x1);
+	out->y1 = max(a->y1, b->y1);
+	out->x2 = min(a->x2, b->x2);
+	out->y2 = min(a->y2, b->y2);
+
+	return !tp_rect_empty(out);
+}
+
+/* Splits a - b into at most 4 disjoint strips, returns the number of strips */
+int tp_rect_subtract(struct tp_rect *out, const struct tp_rect *a,
+		     const struct tp_rect *b)
+{
+	struct tp_rect overlap;
+	int nr = 0;
+
+	if (tp_rect_empty(a))
+		return 0;
+
+	if (!tp_rect_intersect(&overlap, a, b)) {
+		out[nr++] = *a;
+		return nr;
+	}
+
+	if (overlap.y1 > a->y1)
+		out[nr++] = (struct tp_rect){ a->x1, a->y1, a->x2, overlap.y1 };
+	if (overlap.y2 < a->y2)
+		out[nr++] = (struct tp_rect){ a->x1, overlap.y2, a->x2, a->y2 };
+	if (overlap.x1 > a->x1)
+		out[nr++] = (struct tp_rect){ a->x1, overlap.y1, overlap.x1, overlap.y2 };
+	if (overlap.x2 < a->x2)
+		out[nr++] = (struct tp_rect){ overlap.x2, overlap.y1, a->x2, overlap.y2 };
+
+	return nr;
+}
+
+void fill_screen(u8 r, u8 g, u8 b)
+{
+	int y;
+
+	for (y = 0; y < fb_height; y++) {
+		int x = 0;
+
+		while (x < fb_width) {
+			x += draw_pixels(x, y, fb_width - x, r, g, b);
+		}
+	}
+}
+
+void draw_vert_point_damage(int size, int x1, int y1, int y2,
+			    u8 fg_r, u8 fg_g, u8 fg_b,
+			    u8 bg_r, u8 bg_g, u8 bg_b)
+{
+	int radius = max(1, (size - 1) / 2);
+	int base_x = x1 - radius;
+	int old_top = y1 - radius, old_bottom = old_top + size;
+	int new_top = y2 - radius, new_bottom = new_top + size;
+	int y;
+
+	if (y2 > y1) {
+		/* Going down: clear the exposed top, extend the bottom */
+		for (y = old_top; y < min(new_top, old_bottom); y++)
+			draw_h_line(base_x, y, size, bg_r, bg_g, bg_b);
+		for (y = max(old_bottom, new_top); y < new_bottom; y++)
+			draw_h_line(base_x, y, size, fg_r, fg_g, fg_b);
+	} else if (y2 < y1) {
+		/* Going up: clear the exposed bottom, extend the top */
+		for (y = max(new_bottom, old_top); y < old_bottom; y++)
+			draw_h_line(base_x, y, size, bg_r, bg_g, bg_b);
+		for (y = new_top; y < min(old_top, new_bottom); y++)
+			draw_h_line(base_x, y, size, fg_r, fg_g, fg_b);
+	}
+}
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ */
+
+#ifndef _TOUCHPAINT_DRAW_H
+#define _TOUCHPAINT_DRAW_H
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+
+/*
+ * The rendering core only depends on the framebuffer pointer and its
+ * dimensions, so it can also be built in userspace (see tools/touchpaint).
+ * Pixel format is assumed to be ARGB_8888. Rows are fb_stride pixels apart,
+ * which may be more than fb_width.
+ */
+extern u32 __iomem *fb_mem;
+extern int fb_width;
+extern int fb_height;
+extern int fb_stride;
+
+/* Rectangle with exclusive bottom-right corner */
+struct tp_rect {
+	int x1;
+	int y1;
+	int x2;
+	int y2;
+};
+
+static inline bool tp_rect_empty(const struct tp_rect *rect)
+{
+	return rect->x1 >= rect->x2 || rect->y1 >= rect->y2;
+}
+
+int draw_pixels(int x, int y, int count, u8 r, u8 g, u8 b);
+void draw_h_line(int x, int y, int length, u8 r, u8 g, u8 b);
+void draw_point(int x, int y, int size, u8 r, u8 g, u8 b);
+void draw_line(int x1, int y1, int x2, int y2, int size, u8 r, u8 g, u8 b);
+void draw_rect(const struct tp_rect *rect, u8 r, u8 g, u8 b);
+void fill_screen(u8 r, u8 g, u8 b);
+bool tp_rect_intersect(struct tp_rect *out, const struct tp_rect *a,
+		       const struct tp_rect *b);
+int tp_rect_subtract(struct tp_rect *out, const struct tp_rect *a,
+		     const struct tp_rect *b);
+void draw_vert_point_damage(int size, int x1, int y1, int y2,
+			    u8 fg_r, u8 fg_g, u8 fg_b,
+			    u8 bg_r, u8 bg_g, u8 bg_b);
+
+#endif /* _TOUCHPAINT_DRAW_H */
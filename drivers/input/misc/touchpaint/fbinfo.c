@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Framebuffer discovery from the device tree. A simple-framebuffer node
+ * describes everything, but most Qualcomm devices only have the continuous
+ * splash reserved memory region. Panel properties can be added to it with
+ * the same names as simple-framebuffer (width, height, stride, format);
+ * anything missing comes from module parameters or built-in defaults.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/of.h>
+#include <linux/of_address.h>
+#include <linux/string.h>
+
+#include "touchpaint.h"
+
+static const char * const splash_names[] = {
+	"cont_splash_region",
+	"not_cont_splash_region",
+};
+
+static bool is_splash_region(struct device_node *np)
+{
+	const char *label;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(splash_names); i++) {
+		if (!of_node_cmp(np->name, splash_names[i]))
+			return true;
+
+		if (!of_property_read_string(np, "label", &label) &&
+		    !strcmp(label, splash_names[i]))
+			return true;
+	}
+
+	return false;
+}
+
+static struct device_node *find_fb_node(void)
+{
+	struct device_node *np, *parent;
+
+	for_each_compatible_node(np, NULL, "simple-framebuffer") {
+		if (of_device_is_available(np))
+			return np;
+	}
+
+	parent = of_find_node_by_path("/reserved-memory");
+	if (!parent)
+		return NULL;
+
+	for_each_child_of_node(parent, np) {
+		if (is_splash_region(np))
+			break;
+	}
+
+	of_node_put(parent);
+	return np;
+}
+
+/* Fills in every field that the device tree describes, returns false if none */
+bool tp_fb_info_from_dt(struct tp_fb_info *info)
+{
+	struct device_node *np = find_fb_node();
+	struct resource res;
+	u32 val;
+
+	if (!np)
+		return false;
+
+	pr_info("using framebuffer from %pOF\n", np);
+	if (!of_address_to_resource(np, 0, &res)) {
+		info->base = res.start;
+		info->size = resource_size(&res);
+	}
+
+	if (!of_property_read_u32(np, "width", &val))
+		info->width = val;
+	if (!of_property_read_u32(np, "height", &val))
+		info->height = val;
+	if (!of_property_read_u32(np, "stride", &val))
+		info->pitch = val;
+	of_property_read_string(np, "format", &info->format);
+
+	of_node_put(np);
+	return true;
+}
@@ -0,0 +1,601 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Framebuffer mapping. The framebuffer can be mapped write-combining,
+ * write-through, or write-back. Write-back mappings make small and
+ * partial-line writes cheap, but every dirty rectangle must be cleaned to
+ * the point of coherency before the display controller can see it, so all
+ * renderers report what they drew through tp_fb_flush().
+ *
+ * With fb_blocks set, the framebuffer is mapped with the largest blocks that
+ * its physical alignment allows rather than whatever ioremap picks. A
+ * full-screen fill then only needs a handful of TLB entries instead of one
+ * for each 4 KiB page.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/debugfs.h>
+#include <linux/err.h>
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/perf_event.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
+#include <linux/vmalloc.h>
+
+#ifdef CONFIG_ARM64
+#include <asm/cacheflush.h>
+#include <asm/pgtable.h>
+#endif
+
+#include "draw.h"
+#include "stats.h"
+#include "touchpaint.h"
+
+#define BENCH_ITERS 32
+
+static const char * const map_names[FB_MAP_MAX] = {
+	[FB_MAP_WC] = "wc",
+	[FB_MAP_WT] = "wt",
+	[FB_MAP_WB] = "wb",
+};
+
+static const unsigned long map_flags[FB_MAP_MAX] = {
+	[FB_MAP_WC] = MEMREMAP_WC,
+	[FB_MAP_WT] = MEMREMAP_WT,
+	[FB_MAP_WB] = MEMREMAP_WB,
+};
+
+#ifdef CONFIG_ARM64
+/*
+ * Same memory types that ioremap_wc and ioremap_cache use. ioremap_wt is
+ * plain ioremap on arm64, which gives Device memory rather than Normal
+ * write-through, so that one is spelled out here.
+ */
+static const pgprot_t map_prots[FB_MAP_MAX] = {
+	[FB_MAP_WC] = __pgprot(PROT_NORMAL_NC),
+	[FB_MAP_WT] = __pgprot(PROT_DEFAULT | PTE_PXN | PTE_UXN | PTE_DIRTY |
+			       PTE_WRITE | PTE_ATTRINDX(MT_NORMAL_WT)),
+	[FB_MAP_WB] = __pgprot(PROT_NORMAL),
+};
+#endif
+
+#if defined(CONFIG_ARM64) && defined(CONFIG_HAVE_ARCH_HUGE_VMAP)
+#define HAVE_BLOCK_MAP
+#endif
+
+struct fb_mapping {
+	u32 __iomem *mem;
+	/* Only set for block mappings */
+	struct vm_struct *area;
+	/* Mapped with __ioremap rather than memremap */
+	bool ioremapped;
+};
+
+/* Number of mappings at each page table level */
+struct fb_granularity {
+	unsigned int puds;
+	unsigned int pmds;
+	unsigned int ptes;
+};
+
+static phys_addr_t map_phys;
+static size_t map_size;
+static enum tp_fb_map map_type;
+static bool map_blocks;
+static struct fb_mapping live_map;
+bool tp_fb_bench_running;
+
+static void clean_range(u32 __iomem *addr, size_t len)
+{
+#ifdef CONFIG_ARM64
+	__clean_dcache_area_poc((void __force *)addr, len);
+#endif
+}
+
+/* Makes the given area visible to the display, clipped to the screen */
+void tp_fb_flush(const struct tp_rect *rect)
+{
+	struct tp_rect screen = { 0, 0, fb_width, fb_height };
+	struct tp_rect clip;
+	int y;
+
+	if (map_type != FB_MAP_WB || !tp_rect_intersect(&clip, rect, &screen))
+		return;
+
+	/* Full-width areas are contiguous */
+	if (clip.x1 == 0 && clip.x2 == fb_width) {
+		clean_range(fb_mem + (size_t)clip.y1 * fb_stride,
+			    (size_t)(clip.y2 - clip.y1) * fb_stride * sizeof(u32));
+		return;
+	}
+
+	for (y = clip.y1; y < clip.y2; y++)
+		clean_range(fb_mem + (size_t)y * fb_stride + clip.x1,
+			    (clip.x2 - clip.x1) * sizeof(u32));
+}
+
+void tp_fb_flush_all(void)
+{
+	struct tp_rect screen = { 0, 0, fb_width, fb_height };
+
+	tp_fb_flush(&screen);
+}
+
+#ifdef HAVE_BLOCK_MAP
+/*
+ * Maps the framebuffer at a virtual address with the same offset into a
+ * block as the physical address, so that ioremap_page_range can use block
+ * mappings for everything except the unaligned head and tail. Offsetting the
+ * virtual address by a page forces page mappings instead.
+ */
+static int map_block(struct fb_mapping *m, enum tp_fb_map type, bool pages)
+{
+	unsigned long align = map_size >= PUD_SIZE ? PUD_SIZE : PMD_SIZE;
+	/* Page tables only map whole pages, like ioremap */
+	unsigned long offset = map_phys & ~PAGE_MASK;
+	phys_addr_t phys = map_phys - offset;
+	size_t size = PAGE_ALIGN(map_size + offset);
+	unsigned long addr;
+
+	m->area = __get_vm_area(size + 2 * align, VM_IOREMAP, VMALLOC_START,
+				VMALLOC_END);
+	if (!m->area)
+		return -ENOMEM;
+
+	addr = ALIGN((unsigned long)m->area->addr, align) + (phys & (align - 1));
+	if (pages)
+		addr += PAGE_SIZE;
+	if (ioremap_page_range(addr, addr + size, phys, map_prots[type])) {
+		free_vm_area(m->area);
+		return -ENOMEM;
+	}
+
+	m->mem = (u32 __iomem *)(addr + offset);
+	return 0;
+}
+
+static void get_granularity(const struct fb_mapping *m,
+			    struct fb_granularity *gran)
+{
+	unsigned long addr = (unsigned long)m->mem;
+	unsigned long end = addr + map_size;
+
+	memset(gran, 0, sizeof(*gran));
+	while (addr < end) {
+		pgd_t *pgd = pgd_offset_k(addr);
+		pud_t *pud;
+		pmd_t *pmd;
+
+		/* Nothing below an empty entry to count */
+		if (pgd_none(*pgd))
+			break;
+
+		pud = pud_offset(pgd, addr);
+		if (pud_none(*pud))
+			break;
+
+		if (pud_sect(*pud)) {
+			gran->puds++;
+			addr = (addr & PUD_MASK) + PUD_SIZE;
+			continue;
+		}
+
+		pmd = pmd_offset(pud, addr);
+		if (pmd_none(*pmd))
+			break;
+
+		if (pmd_sect(*pmd)) {
+			gran->pmds++;
+			addr = (addr & PMD_MASK) + PMD_SIZE;
+			continue;
+		}
+
+		gran->ptes++;
+		addr = (addr & PAGE_MASK) + PAGE_SIZE;
+	}
+}
+#else
+static int map_block(struct fb_mapping *m, enum tp_fb_map type, bool pages)
+{
+	return -EOPNOTSUPP;
+}
+
+/* Only block mappings are walked, so everything else is reported as pages */
+static void get_granularity(const struct fb_mapping *m,
+			    struct fb_granularity *gran)
+{
+	*gran = (struct fb_granularity){ .ptes = DIV_ROUND_UP(map_size, PAGE_SIZE) };
+}
+#endif
+
+static int map(struct fb_mapping *m, enum tp_fb_map type, bool blocks)
+{
+	m->area = NULL;
+	m->ioremapped = false;
+	if (blocks && !map_block(m, type, false))
+		return 0;
+
+#ifdef CONFIG_ARM64
+	/* memremap would give Device memory for write-through */
+	if (type == FB_MAP_WT) {
+		m->mem = (u32 __iomem *)__ioremap(map_phys, map_size,
+						  map_prots[type]);
+		m->ioremapped = true;
+		return m->mem ? 0 : -ENOMEM;
+	}
+#endif
+
+	m->mem = (u32 __force __iomem *)memremap(map_phys, map_size, map_flags[type]);
+	return m->mem ? 0 : -ENOMEM;
+}
+
+static void unmap(struct fb_mapping *m)
+{
+	if (m->area)
+		free_vm_area(m->area);
+	else if (m->ioremapped)
+		iounmap(m->mem);
+	else
+		memunmap((void __force *)m->mem);
+}
+
+/*
+ * Unmaps after writing back and dropping any cached lines, so that nothing
+ * written through this mapping is lost and a later mapping of another type
+ * can't hit stale lines.
+ */
+static void retire(struct fb_mapping *m, enum tp_fb_map type)
+{
+#ifdef CONFIG_ARM64
+	if (type != FB_MAP_WC)
+		__flush_dcache_area((void __force *)m->mem, map_size);
+#endif
+	unmap(m);
+}
+
+int tp_fb_map(phys_addr_t phys, size_t size, enum tp_fb_map type, bool blocks)
+{
+	struct fb_granularity gran;
+	int ret;
+
+	map_phys = phys;
+	map_size = size;
+
+#ifndef CONFIG_ARM64
+	if (type == FB_MAP_WB) {
+		pr_warn("write-back framebuffer requires arm64 cache maintenance, using write-combining\n");
+		type = FB_MAP_WC;
+	}
+#endif
+	if ((unsigned int)type >= FB_MAP_MAX)
+		type = FB_MAP_WC;
+
+	ret = map(&live_map, type, blocks);
+	if (ret)
+		return ret;
+
+	if (blocks && !live_map.area)
+		pr_warn("block mappings are unavailable, falling back to ioremap\n");
+
+	fb_mem = live_map.mem;
+	map_type = type;
+	map_blocks = blocks;
+
+	get_granularity(&live_map, &gran);
+	pr_info("framebuffer mapped as %s with %u %luK, %u %luK, and %u %luK mappings\n",
+		map_names[type], gran.puds, PUD_SIZE / SZ_1K, gran.pmds,
+		PMD_SIZE / SZ_1K, gran.ptes, PAGE_SIZE / SZ_1K);
+	return 0;
+}
+
+void tp_fb_unmap(void)
+{
+	unmap(&live_map);
+	fb_mem = NULL;
+}
+
+struct fb_bench {
+	const char *name;
+	int arg;
+	void (*fn)(int arg, struct tp_rect *dirty);
+};
+
+static void bench_point(int size, struct tp_rect *dirty)
+{
+	int x = fb_width / 2, y = fb_height / 2;
+	int radius = max(1, (size - 1) / 2);
+
+	draw_point(x, y, size, 255, 255, 255);
+	*dirty = (struct tp_rect){ x - radius, y - radius,
+				   x - radius + size, y - radius + size };
+}
+
+static void bench_h_line(int length, struct tp_rect *dirty)
+{
+	int y = fb_height / 2;
+
+	draw_h_line(0, y, length, 255, 255, 255);
+	*dirty = (struct tp_rect){ 0, y, length, y + 1 };
+}
+
+static void bench_line(int size, struct tp_rect *dirty)
+{
+	int x2 = fb_width / 4, y2 = fb_height / 4;
+
+	draw_line(0, 0, x2, y2, size, 255, 255, 255);
+	*dirty = (struct tp_rect){ -size, -size, x2 + size, y2 + size };
+}
+
+/* The follow box moving by one touch sample */
+static void bench_damage(int size, struct tp_rect *dirty)
+{
+	static int step = 7;
+	static int y;
+	int radius = max(1, (size - 1) / 2);
+	int x = fb_width / 2;
+
+	if (!y || y > fb_height / 2 + 100 || y < fb_height / 2 - 100) {
+		y = fb_height / 2;
+		step = -step;
+	}
+
+	draw_vert_point_damage(size, x, y, y + step, 255, 255, 0, 64, 0, 128);
+	*dirty = (struct tp_rect){ x - radius, min(y, y + step) - radius,
+				   x - radius + size,
+				   max(y, y + step) - radius + size };
+	y += step;
+}
+
+static void bench_fill(int unused, struct tp_rect *dirty)
+{
+	fill_screen(64, 0, 128);
+	*dirty = (struct tp_rect){ 0, 0, fb_width, fb_height };
+}
+
+static const struct fb_bench benches[] = {
+	{ "draw_point", 2, bench_point },
+	{ "draw_point", 9, bench_point },
+	{ "draw_point", 32, bench_point },
+	{ "draw_point", 301, bench_point },
+	{ "draw_h_line", 64, bench_h_line },
+	{ "draw_h_line", 1080, bench_h_line },
+	{ "draw_line", 2, bench_line },
+	{ "draw_line", 9, bench_line },
+	{ "vert_point_damage", 301, bench_damage },
+	{ "fill_screen", 0, bench_fill },
+};
+
+/*
+ * Mappings of the same memory with different types aren't coherent with
+ * each other, so the live mapping is dropped while benchmarks map the
+ * framebuffer themselves.
+ */
+static void bench_start(void)
+{
+	WRITE_ONCE(tp_fb_bench_running, true);
+	retire(&live_map, map_type);
+}
+
+/* Maps the framebuffer again and resumes touch rendering */
+static void bench_end(enum tp_fb_map type)
+{
+	if (map(&live_map, type, map_blocks)) {
+		pr_err("failed to map framebuffer again, rendering stays paused!\n");
+		return;
+	}
+
+	fb_mem = live_map.mem;
+	map_type = type;
+	memset_io(fb_mem, 0, (size_t)fb_stride * fb_height * sizeof(u32));
+	tp_fb_flush_all();
+	tp_hud_invalidate();
+	WRITE_ONCE(tp_fb_bench_running, false);
+}
+
+/* Average time of a primitive including cache maintenance */
+static u64 run_bench(const struct fb_bench *bench)
+{
+	struct tp_rect dirty;
+	u64 start;
+	int i;
+
+	bench->fn(bench->arg, &dirty);
+	tp_fb_flush(&dirty);
+
+	start = ktime_get_ns();
+	for (i = 0; i < BENCH_ITERS; i++) {
+		bench->fn(bench->arg, &dirty);
+		tp_fb_flush(&dirty);
+	}
+
+	return div_u64(ktime_get_ns() - start, BENCH_ITERS);
+}
+
+/*
+ * Runs every primitive against the real framebuffer with each mapping type.
+ * Touch rendering is paused while this runs, but animations should be
+ * stopped first.
+ */
+static int fb_bench_show(struct seq_file *m, void *unused)
+{
+	u64 results[ARRAY_SIZE(benches)][FB_MAP_MAX];
+	enum tp_fb_map saved_type = map_type;
+	struct fb_mapping fbm;
+	enum tp_fb_map type;
+	int i;
+
+	bench_start();
+	for (type = 0; type < FB_MAP_MAX; type++) {
+		if (map(&fbm, type, map_blocks)) {
+			for (i = 0; i < ARRAY_SIZE(benches); i++)
+				results[i][type] = 0;
+			continue;
+		}
+
+		fb_mem = fbm.mem;
+		map_type = type;
+		for (i = 0; i < ARRAY_SIZE(benches); i++)
+			results[i][type] = run_bench(&benches[i]);
+
+		retire(&fbm, type);
+	}
+	bench_end(saved_type);
+
+	seq_printf(m, "%-20s %6s %10s %10s %10s\n", "primitive", "arg",
+		   "wc_ns", "wt_ns", "wb_ns");
+	for (i = 0; i < ARRAY_SIZE(benches); i++)
+		seq_printf(m, "%-20s %6d %10llu %10llu %10llu\n",
+			   benches[i].name, benches[i].arg,
+			   results[i][FB_MAP_WC], results[i][FB_MAP_WT],
+			   results[i][FB_MAP_WB]);
+
+	return 0;
+}
+
+static int fb_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fb_bench_show, NULL);
+}
+
+static const struct file_operations fb_bench_fops = {
+	.owner		= THIS_MODULE,
+	.open		= fb_bench_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static struct perf_event *create_tlb_counter(void)
+{
+	struct perf_event_attr attr = {
+		.size = sizeof(attr),
+		.pinned = 1,
+		.disabled = 1,
+#ifdef CONFIG_ARM64
+		/* L1D_TLB_REFILL counts both reads and writes */
+		.type = PERF_TYPE_RAW,
+		.config = 0x05,
+#else
+		.type = PERF_TYPE_HW_CACHE,
+		.config = PERF_COUNT_HW_CACHE_DTLB |
+			  (PERF_COUNT_HW_CACHE_OP_WRITE << 8) |
+			  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+#endif
+	};
+
+	return perf_event_create_kernel_counter(&attr, -1, current, NULL, NULL);
+}
+
+static u64 read_counter(struct perf_event *event)
+{
+	u64 enabled, running;
+
+	return perf_event_read_value(event, &enabled, &running);
+}
+
+/* A 2-pixel column touches a different page on every row */
+static void tlb_column(int unused, struct tp_rect *dirty)
+{
+	int x = fb_width / 2;
+
+	draw_line(x, 0, x, fb_height - 1, 2, 255, 255, 255);
+	*dirty = (struct tp_rect){ x - 1, 0, x + 2, fb_height };
+}
+
+static const struct fb_bench tlb_benches[] = {
+	{ "fill_screen", 0, bench_fill },
+	{ "column", 2, tlb_column },
+};
+
+/*
+ * Compares dTLB refills with page and block mappings of the framebuffer,
+ * using the current memory type. Same caveats as fb_bench. Without block
+ * mapping support, only the ioremap mapping is measured.
+ */
+static int fb_tlb_show(struct seq_file *m, void *unused)
+{
+	u64 ns[ARRAY_SIZE(tlb_benches)][2], refills[ARRAY_SIZE(tlb_benches)][2];
+	struct fb_granularity gran[2] = {};
+	struct perf_event *event;
+	struct fb_mapping fbm;
+	int i, blocks;
+
+	event = create_tlb_counter();
+	if (IS_ERR(event)) {
+		seq_printf(m, "failed to create dTLB refill counter! err=%ld\n",
+			   PTR_ERR(event));
+		return 0;
+	}
+
+	memset(ns, 0, sizeof(ns));
+	memset(refills, 0, sizeof(refills));
+	bench_start();
+	for (blocks = 0; blocks < 2; blocks++) {
+		if (map_block(&fbm, map_type, !blocks)) {
+			if (blocks || map(&fbm, map_type, false))
+				continue;
+		}
+
+		get_granularity(&fbm, &gran[blocks]);
+		fb_mem = fbm.mem;
+		for (i = 0; i < ARRAY_SIZE(tlb_benches); i++) {
+			u64 start_refills;
+
+			perf_event_enable(event);
+			start_refills = read_counter(event);
+			ns[i][blocks] = run_bench(&tlb_benches[i]);
+			/* Includes the warm-up run */
+			refills[i][blocks] = div_u64(read_counter(event) - start_refills,
+						     BENCH_ITERS + 1);
+			perf_event_disable(event);
+		}
+
+		retire(&fbm, map_type);
+	}
+	bench_end(map_type);
+	perf_event_release_kernel(event);
+
+	for (blocks = 0; blocks < 2; blocks++)
+		seq_printf(m, "%-6s mapping: %u %luK, %u %luK, %u %luK\n",
+			   blocks ? "block" : "page", gran[blocks].puds,
+			   PUD_SIZE / SZ_1K, gran[blocks].pmds, PMD_SIZE / SZ_1K,
+			   gran[blocks].ptes, PAGE_SIZE / SZ_1K);
+
+	seq_printf(m, "\n%-12s %10s %10s %12s %12s\n", "primitive", "page_ns",
+		   "block_ns", "page_refills", "block_refills");
+	for (i = 0; i < ARRAY_SIZE(tlb_benches); i++)
+		seq_printf(m, "%-12s %10llu %10llu %12llu %12llu\n",
+			   tlb_benches[i].name, ns[i][0], ns[i][1],
+			   refills[i][0], refills[i][1]);
+
+	return 0;
+}
+
+static int fb_tlb_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fb_tlb_show, NULL);
+}
+
+static const struct file_operations fb_tlb_fops = {
+	.owner		= THIS_MODULE,
+	.open		= fb_tlb_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void tp_fb_bench_init(void)
+{
+	struct dentry *dir = tp_debugfs_dir();
+
+	if (!dir)
+		return;
+
+	debugfs_create_file("fb_bench", 0400, dir, NULL, &fb_bench_fops);
+	debugfs_create_file("fb_tlb", 0400, dir, NULL, &fb_tlb_fops);
+}
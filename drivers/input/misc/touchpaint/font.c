@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Tiny 1-bpp bitmap font and glyph blitter. Each glyph row is a byte with
+ * the leftmost pixel in the MSB. Rows are expanded to pixels one nibble at a
+ * time through a lookup table that is rebuilt whenever the colors or scale
+ * change, so blitting a glyph is just a series of copies.
+ */
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#include "draw.h"
+#include "font.h"
+
+#define FONT_FIRST ' '
+#define FONT_LAST 'Z'
+
+static const u8 font_glyphs[FONT_LAST - FONT_FIRST + 1][FONT_HEIGHT] = {
+	[' ' - FONT_FIRST] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+	['%' - FONT_FIRST] = { 0x60, 0x64, 0x08, 0x10, 0x20, 0x4c, 0x0c, 0x00 },
+	['-' - FONT_FIRST] = { 0x00, 0x00, 0x00, 0x7c, 0x00, 0x00, 0x00, 0x00 },
+	['.' - FONT_FIRST] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x30, 0x00 },
+	['/' - FONT_FIRST] = { 0x00, 0x04, 0x08, 0x10, 0x20, 0x40, 0x00, 0x00 },
+	['0' - FONT_FIRST] = { 0x38, 0x44, 0x4c, 0x54, 0x64, 0x44, 0x38, 0x00 },
+	['1' - FONT_FIRST] = { 0x10, 0x30, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00 },
+	['2' - FONT_FIRST] = { 0x38, 0x44, 0x04, 0x08, 0x10, 0x20, 0x7c, 0x00 },
+	['3' - FONT_FIRST] = { 0x7c, 0x08, 0x10, 0x08, 0x04, 0x44, 0x38, 0x00 },
+	['4' - FONT_FIRST] = { 0x08, 0x18, 0x28, 0x48, 0x7c, 0x08, 0x08, 0x00 },
+	['5' - FONT_FIRST] = { 0x7c, 0x40, 0x78, 0x04, 0x04, 0x44, 0x38, 0x00 },
+	['6' - FONT_FIRST] = { 0x18, 0x20, 0x40, 0x78, 0x44, 0x44, 0x38, 0x00 },
+	['7' - FONT_FIRST] = { 0x7c, 0x04, 0x08, 0x10, 0x20, 0x20, 0x20, 0x00 },
+	['8' - FONT_FIRST] = { 0x38, 0x44, 0x44, 0x38, 0x44, 0x44, 0x38, 0x00 },
+	['9' - FONT_FIRST] = { 0x38, 0x44, 0x44, 0x3c, 0x04, 0x08, 0x30, 0x00 },
+	[':' - FONT_FIRST] = { 0x00, 0x30, 0x30, 0x00, 0x30, 0x30, 0x00, 0x00 },
+	['A' - FONT_FIRST] = { 0x38, 0x44, 0x44, 0x7c, 0x44, 0x44, 0x44, 0x00 },
+	['B' - FONT_FIRST] = { 0x78, 0x44, 0x44, 0x78, 0x44, 0x44, 0x78, 0x00 },
+	['C' - FONT_FIRST] = { 0x38, 0x44, 0x40, 0x40, 0x40, 0x44, 0x38, 0x00 },
+	['D' - FONT_FIRST] = { 0x70, 0x48, 0x44, 0x44, 0x44, 0x48, 0x70, 0x00 },
+	['E' - FONT_FIRST] = { 0x7c, 0x40, 0x40, 0x78, 0x40, 0x40, 0x7c, 0x00 },
+	['F' - FONT_FIRST] = { 0x7c, 0x40, 0x40, 0x78, 0x40, 0x40, 0x40, 0x00 },
+	['G' - FONT_FIRST] = { 0x38, 0x44, 0x40, 0x5c, 0x44, 0x44, 0x3c, 0x00 },
+	['H' - FONT_FIRST] = { 0x44, 0x44, 0x44, 0x7c, 0x44, 0x44, 0x44, 0x00 },
+	['I' - FONT_FIRST] = { 0x38, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00 },
+	['J' - FONT_FIRST] = { 0x1c, 0x08, 0x08, 0x08, 0x08, 0x48, 0x30, 0x00 },
+	['K' - FONT_FIRST] = { 0x44, 0x48, 0x50, 0x60, 0x50, 0x48, 0x44, 0x00 },
+	['L' - FONT_FIRST] = { 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x7c, 0x00 },
+	['M' - FONT_FIRST] = { 0x44, 0x6c, 0x54, 0x54, 0x44, 0x44, 0x44, 0x00 },
+	['N' - FONT_FIRST] = { 0x44, 0x44, 0x64, 0x54, 0x4c, 0x44, 0x44, 0x00 },
+	['O' - FONT_FIRST] = { 0x38, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00 },
+	['P' - FONT_FIRST] = { 0x78, 0x44, 0x44, 0x78, 0x40, 0x40, 0x40, 0x00 },
+	['Q' - FONT_FIRST] = { 0x38, 0x44, 0x44, 0x44, 0x54, 0x48, 0x34, 0x00 },
+	['R' - FONT_FIRST] = { 0x78, 0x44, 0x44, 0x78, 0x50, 0x48, 0x44, 0x00 },
+	['S' - FONT_FIRST] = { 0x3c, 0x40, 0x40, 0x38, 0x04, 0x04, 0x78, 0x00 },
+	['T' - FONT_FIRST] = { 0x7c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00 },
+	['U' - FONT_FIRST] = { 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00 },
+	['V' - FONT_FIRST] = { 0x44, 0x44, 0x44, 0x44, 0x44, 0x28, 0x10, 0x00 },
+	['W' - FONT_FIRST] = { 0x44, 0x44, 0x44, 0x54, 0x54, 0x54, 0x28, 0x00 },
+	['X' - FONT_FIRST] = { 0x44, 0x44, 0x28, 0x10, 0x28, 0x44, 0x44, 0x00 },
+	['Y' - FONT_FIRST] = { 0x44, 0x44, 0x44, 0x28, 0x10, 0x10, 0x10, 0x00 },
+	['Z' - FONT_FIRST] = { 0x7c, 0x04, 0x08, 0x10, 0x20, 0x40, 0x7c, 0x00 },
+};
+
+/* Expanded pixels for each nibble at the current scale */
+static u32 nibble_lut[16][4 * FONT_MAX_SCALE];
+static int font_scale = 1;
+
+void font_set_style(u32 fg, u32 bg, int scale)
+{
+	int nibble, bit, i;
+
+	font_scale = clamp(scale, 1, FONT_MAX_SCALE);
+
+	for (nibble = 0; nibble < 16; nibble++) {
+		for (bit = 0; bit < 4; bit++) {
+			u32 pixel = nibble & (8 >> bit) ? fg : bg;
+
+			for (i = 0; i < font_scale; i++)
+				nibble_lut[nibble][bit * font_scale + i] = pixel;
+		}
+	}
+}
+
+int font_cell_width(void)
+{
+	return FONT_WIDTH * font_scale;
+}
+
+int font_cell_height(void)
+{
+	return FONT_HEIGHT * font_scale;
+}
+
+static void write_row(u32 __iomem *dst, const u32 *src, int count)
+{
+	int i;
+
+	/* Cells are always an even number of pixels wide */
+	for (i = 0; i < count; i += 2)
+		*(volatile u64 *)(dst + i) = *(const u64 *)(src + i);
+}
+
+void draw_glyph(int x, int y, char c)
+{
+	u32 row_px[FONT_WIDTH * FONT_MAX_SCALE];
+	int nibble_px = 4 * font_scale;
+	int width = font_cell_width();
+	const u8 *glyph;
+	int row, i;
+
+	if (x < 0 || y < 0 || x + width > fb_width ||
+	    y + font_cell_height() > fb_height)
+		return;
+
+	if (c >= 'a' && c <= 'z')
+		c -= 'a' - 'A';
+	if (c < FONT_FIRST || c > FONT_LAST)
+		c = FONT_FIRST;
+
+	glyph = font_glyphs[c - FONT_FIRST];
+	for (row = 0; row < FONT_HEIGHT; row++) {
+		u8 bits = glyph[row];
+		u32 __iomem *dst = fb_mem + x + (size_t)(y + row * font_scale) * fb_stride;
+
+		memcpy(row_px, nibble_lut[bits >> 4], nibble_px * sizeof(u32));
+		memcpy(row_px + nibble_px, nibble_lut[bits & 0xf],
+		       nibble_px * sizeof(u32));
+
+		for (i = 0; i < font_scale; i++) {
+			write_row(dst, row_px, width);
+			dst += fb_stride;
+		}
+	}
+}
+
+void draw_text(int x, int y, const char *text)
+{
+	for (; *text; text++) {
+		draw_glyph(x, y, *text);
+		x += font_cell_width();
+	}
+}
@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ */
+
+#ifndef _TOUCHPAINT_FONT_H
+#define _TOUCHPAINT_FONT_H
+
+#include <linux/types.h>
+
+/* Glyphs are 5x7, padded to an 8x8 cell */
+#define FONT_WIDTH 8
+#define FONT_HEIGHT 8
+#define FONT_MAX_SCALE 4
+
+void font_set_style(u32 fg, u32 bg, int scale);
+int font_cell_width(void);
+int font_cell_height(void);
+void draw_glyph(int x, int y, char c);
+void draw_text(int x, int y, const char *text);
+
+#endif /* _TOUCHPAINT_FONT_H */
@@ -0,0 +1,263 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * CPU frequency floor while touching. The touch and render CPUs are often
+ * at a low frequency when a stroke starts, so the first few frames take
+ * several times longer to render until the governor catches up. While the
+ * shared touch CPU tracker holds those CPUs, the minimum frequency of their
+ * policies is raised to freq_floor_pct of their maximum. Other policies and
+ * the governor's choice above the floor are left alone.
+ *
+ * Render time is also recorded by the frequency that the render CPU was at,
+ * which shows the effect of the floor. That runs in the input callback on
+ * every frame, so each CPU's policy is cached from the policy notifier and
+ * its current frequency is read directly. Transition notifiers would miss
+ * policies that switch frequency from the scheduler.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/cpufreq.h>
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/notifier.h>
+#include <linux/percpu.h>
+#include <linux/rcupdate.h>
+#include <linux/seq_file.h>
+#include <linux/smp.h>
+
+#include "stats.h"
+#include "touchpaint.h"
+
+/* Frequency bands as a percentage of the CPU's maximum */
+#define FREQ_BAND_MID_PCT 50
+#define FREQ_BAND_HIGH_PCT 80
+
+static DEFINE_TP_STAT(render_low_stat, "render_freq_low");
+static DEFINE_TP_STAT(render_mid_stat, "render_freq_mid");
+static DEFINE_TP_STAT(render_high_stat, "render_freq_high");
+
+/* Policy of each CPU, freed only after the notifier clears it */
+static DEFINE_PER_CPU(struct cpufreq_policy __rcu *, cpu_policy);
+/* Read by the policy notifier, written by the worker */
+static struct cpumask floor_cpus;
+static int floor_pct;
+/* Worker only */
+static bool held;
+static u64 held_start_ns;
+static u64 held_total_ns;
+static unsigned int nr_holds;
+
+static void cache_policy(struct cpufreq_policy *policy)
+{
+	int cpu;
+
+	for_each_cpu(cpu, policy->related_cpus)
+		rcu_assign_pointer(per_cpu(cpu_policy, cpu), policy);
+}
+
+static void uncache_policy(struct cpufreq_policy *policy)
+{
+	int cpu;
+
+	for_each_cpu(cpu, policy->related_cpus)
+		RCU_INIT_POINTER(per_cpu(cpu_policy, cpu), NULL);
+
+	/* The policy is freed as soon as the notifier returns */
+	synchronize_rcu();
+}
+
+static int freq_policy_notifier(struct notifier_block *nb,
+				unsigned long event, void *data)
+{
+	struct cpufreq_policy *policy = data;
+	unsigned int floor_khz;
+	int pct = READ_ONCE(floor_pct);
+
+	if (event == CPUFREQ_CREATE_POLICY) {
+		cache_policy(policy);
+		return NOTIFY_OK;
+	}
+
+	if (event == CPUFREQ_REMOVE_POLICY) {
+		uncache_policy(policy);
+		return NOTIFY_OK;
+	}
+
+	if (event != CPUFREQ_ADJUST || pct <= 0 ||
+	    !cpumask_intersects(policy->related_cpus, &floor_cpus))
+		return NOTIFY_OK;
+
+	/* Thermal and user limits on the maximum still win */
+	floor_khz = mult_frac(policy->cpuinfo.max_freq, min(pct, 100), 100);
+	policy->min = max(policy->min, min(floor_khz, policy->max));
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block freq_policy_nb = {
+	.notifier_call = freq_policy_notifier,
+};
+
+/* Re-evaluates the policies of the given CPUs against the current floor */
+static void update_policies(const struct cpumask *cpus)
+{
+	struct cpumask pending;
+	int cpu;
+
+	cpumask_copy(&pending, cpus);
+	for_each_cpu(cpu, &pending) {
+		struct cpufreq_policy *policy = cpufreq_cpu_get(cpu);
+
+		if (!policy)
+			continue;
+
+		cpumask_andnot(&pending, &pending, policy->related_cpus);
+		cpufreq_cpu_put(policy);
+		cpufreq_update_policy(cpu);
+	}
+}
+
+/* Called from the timer worker when the hold time runs out */
+void tp_freq_release(void)
+{
+	if (!held)
+		return;
+
+	WRITE_ONCE(floor_pct, 0);
+	update_policies(&floor_cpus);
+	held_total_ns += ktime_get_ns() - held_start_ns;
+	held = false;
+}
+
+/* Called from the timer worker when the set of CPUs involved changes */
+void tp_freq_hold(const struct cpumask *cpus)
+{
+	struct cpumask old;
+	int pct = READ_ONCE(tp_freq_floor_pct);
+
+	/* The floor was turned off during a hold */
+	if (pct <= 0) {
+		tp_freq_release();
+		return;
+	}
+
+	if (!held) {
+		nr_holds++;
+		held_start_ns = ktime_get_ns();
+	}
+
+	/* Policies of CPUs that are no longer involved drop their floor */
+	cpumask_copy(&old, &floor_cpus);
+	cpumask_copy(&floor_cpus, cpus);
+	WRITE_ONCE(floor_pct, pct);
+	held = true;
+
+	cpumask_or(&old, &old, &floor_cpus);
+	update_policies(&old);
+}
+
+/* Records render time by the current frequency of the CPU it ended on */
+void tp_freq_add_render(u64 ns)
+{
+	struct cpufreq_policy *policy;
+	unsigned int cur = 0, max = 0;
+
+	rcu_read_lock();
+	policy = rcu_dereference(per_cpu(cpu_policy, raw_smp_processor_id()));
+	if (policy) {
+		cur = READ_ONCE(policy->cur);
+		max = policy->cpuinfo.max_freq;
+	}
+	rcu_read_unlock();
+
+	if (!cur || !max)
+		return;
+
+	if (cur * 100ULL < max * FREQ_BAND_MID_PCT)
+		tp_stat_add(&render_low_stat, ns);
+	else if (cur * 100ULL < max * FREQ_BAND_HIGH_PCT)
+		tp_stat_add(&render_mid_stat, ns);
+	else
+		tp_stat_add(&render_high_stat, ns);
+}
+
+static int freq_floor_show(struct seq_file *m, void *unused)
+{
+	int cpu;
+
+	seq_printf(m, "floor: %d%% of max, held %u times for %llu ms total%s\n",
+		   tp_freq_floor_pct, nr_holds, div_u64(held_total_ns, NSEC_PER_MSEC),
+		   held ? " (held now, not yet counted)" : "");
+	seq_printf(m, "CPUs: %*pbl\n\n", cpumask_pr_args(&floor_cpus));
+	seq_printf(m, "%-4s %10s %10s %10s\n", "cpu", "cur_khz", "min_khz",
+		   "max_khz");
+
+	for_each_online_cpu(cpu) {
+		struct cpufreq_policy *policy = cpufreq_cpu_get(cpu);
+
+		if (!policy)
+			continue;
+
+		if (cpu == cpumask_first(policy->related_cpus))
+			seq_printf(m, "%-4d %10u %10u %10u\n", cpu, policy->cur,
+				   policy->min, policy->max);
+
+		cpufreq_cpu_put(policy);
+	}
+
+	return 0;
+}
+
+static int freq_floor_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, freq_floor_show, NULL);
+}
+
+static const struct file_operations freq_floor_fops = {
+	.owner		= THIS_MODULE,
+	.open		= freq_floor_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void tp_freq_init(void)
+{
+	int cpu, ret;
+
+	tp_stat_register(&render_low_stat);
+	tp_stat_register(&render_mid_stat);
+	tp_stat_register(&render_high_stat);
+
+	ret = cpufreq_register_notifier(&freq_policy_nb,
+					CPUFREQ_POLICY_NOTIFIER);
+	if (ret) {
+		pr_warn("failed to register cpufreq notifier! err=%d\n", ret);
+		return;
+	}
+
+	/* Policies created before the notifier was registered */
+	for_each_possible_cpu(cpu) {
+		struct cpufreq_policy *policy = cpufreq_cpu_get(cpu);
+
+		if (!policy)
+			continue;
+
+		rcu_assign_pointer(per_cpu(cpu_policy, cpu), policy);
+		cpufreq_cpu_put(policy);
+	}
+}
+
+void tp_freq_debugfs_init(void)
+{
+	struct dentry *dir = tp_debugfs_dir();
+
+	if (dir)
+		debugfs_create_file("freq_floor", 0400, dir, NULL,
+				    &freq_floor_fops);
+}
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Tracks the CPUs involved in a touch for the idle latency constraint and
+ * the frequency floor. From the first finger down until idle_hold_ms after
+ * the last finger up, the CPUs that handled touch input or rendering are
+ * held. Both are told whenever the set of CPUs changes and when the hold
+ * ends.
+ *
+ * Holding can sleep, so it's done from the timer worker. CPUs are recorded
+ * as they show up and each new one updates the hold.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/cpumask.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/smp.h>
+
+#include "timer.h"
+#include "touchpaint.h"
+
+/* CPUs that handled touch input or rendering */
+static struct cpumask seen_cpus;
+/* From the first finger down until the hold time runs out */
+static bool touching;
+/* Worker only */
+static struct cpumask held_cpus;
+static bool held;
+
+static struct tp_timer hold_timer;
+static struct tp_timer release_timer;
+
+static void hold_callback(struct tp_timer *timer)
+{
+	if (held && cpumask_equal(&held_cpus, &seen_cpus))
+		return;
+
+	cpumask_copy(&held_cpus, &seen_cpus);
+	held = true;
+	tp_qos_hold(&held_cpus);
+	tp_freq_hold(&held_cpus);
+}
+
+static void release_callback(struct tp_timer *timer)
+{
+	WRITE_ONCE(touching, false);
+	if (!held)
+		return;
+
+	held = false;
+	tp_qos_release();
+	tp_freq_release();
+}
+
+/* Called from the input callback when the first finger goes down */
+void tp_hold_touch_down(void)
+{
+	/* Start over with only the CPUs involved in this touch */
+	if (!READ_ONCE(touching))
+		cpumask_clear(&seen_cpus);
+
+	WRITE_ONCE(touching, true);
+	tp_hold_note_cpu();
+	tp_timer_cancel(&release_timer);
+	tp_timer_start(&hold_timer, 0);
+}
+
+/* Called from the input callback when the last finger goes up */
+void tp_hold_touch_up(void)
+{
+	tp_timer_start(&release_timer,
+		       (u64)max(READ_ONCE(tp_idle_hold_ms), 0) * NSEC_PER_MSEC);
+}
+
+/* Adds the current CPU to the hold, called from touch and render paths */
+void tp_hold_note_cpu(void)
+{
+	int cpu = raw_smp_processor_id();
+
+	if (cpumask_test_cpu(cpu, &seen_cpus))
+		return;
+
+	cpumask_set_cpu(cpu, &seen_cpus);
+	if (READ_ONCE(touching))
+		tp_timer_start(&hold_timer, 0);
+}
+
+void tp_hold_init(void)
+{
+	tp_timer_init(&hold_timer, hold_callback);
+	tp_timer_init(&release_timer, release_callback);
+}
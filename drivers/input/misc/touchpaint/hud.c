@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * On-screen latency HUD. The text has a fixed layout and only characters
+ * that changed since the last update are redrawn, so updating it after
+ * every frame only costs a few glyph blits.
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+
+#include "draw.h"
+#include "font.h"
+#include "stats.h"
+#include "touchpaint.h"
+
+#define HUD_MARGIN 8
+#define HUD_COLS 45
+
+static char shown[HUD_COLS + 1];
+static bool valid;
+
+static DEFINE_TP_STAT(hud_stat, "hud");
+
+static unsigned int ns_to_hud_us(u64 ns)
+{
+	return min_t(u64, div_u64(ns, NSEC_PER_USEC), 9999);
+}
+
+void tp_hud_invalidate(void)
+{
+	valid = false;
+}
+
+void tp_hud_update(struct tp_stat *render, unsigned int sample_hz,
+		   const char *mode_name)
+{
+	char text[HUD_COLS + 1];
+	u64 start = ktime_get_ns();
+	int len, cell, i;
+
+	len = scnprintf(text, sizeof(text),
+			"LAST %4u P50 %4u P99 %4u US %3u HZ %s",
+			ns_to_hud_us(render->last_ns),
+			ns_to_hud_us(tp_stat_percentile(render, 50)),
+			ns_to_hud_us(tp_stat_percentile(render, 99)),
+			min(sample_hz, 999U), mode_name);
+	memset(text + len, ' ', HUD_COLS - len);
+	text[HUD_COLS] = '\0';
+
+	if (!valid) {
+		font_set_style(0xffffffff, 0xff000000,
+			       fb_width / (HUD_COLS * FONT_WIDTH));
+		memset(shown, 0, sizeof(shown));
+		valid = true;
+	}
+
+	cell = font_cell_width();
+	for (i = 0; i < HUD_COLS; i++) {
+		if (text[i] == shown[i])
+			continue;
+
+		draw_glyph(HUD_MARGIN + i * cell, HUD_MARGIN, text[i]);
+		shown[i] = text[i];
+		tp_fb_flush(&(struct tp_rect){ HUD_MARGIN + i * cell, HUD_MARGIN,
+					       HUD_MARGIN + (i + 1) * cell,
+					       HUD_MARGIN + font_cell_height() });
+	}
+
+	tp_stat_add(&hud_stat, ktime_get_ns() - start);
+}
+
+/* Area covered by the HUD, empty if it hasn't been drawn yet */
+void tp_hud_area(struct tp_rect *rect)
+{
+	if (!valid) {
+		*rect = (struct tp_rect){ 0 };
+		return;
+	}
+
+	rect->x1 = HUD_MARGIN;
+	rect->y1 = HUD_MARGIN;
+	rect->x2 = HUD_MARGIN + HUD_COLS * font_cell_width();
+	rect->y2 = HUD_MARGIN + font_cell_height();
+}
+
+void tp_hud_init(void)
+{
+	tp_stat_register(&hud_stat);
+}
@@ -0,0 +1,270 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Paint mode stroke rendering. Segments are either drawn immediately in the
+ * input callback or queued per slot. Queued segments are drawn by a worker
+ * on the CPU the slot is assigned to, so 10 fingers can be rendered in
+ * parallel, or batched and drawn together just before the next vblank. Each
+ * slot has its own queue and each batch tracks its own dirty area, so
+ * workers never share state.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/cpumask.h>
+#include <linux/err.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/version.h>
+#include <linux/wait.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 10, 0)
+#include <uapi/linux/sched/types.h>
+#endif
+
+#include "brush.h"
+#include "draw.h"
+#include "paint.h"
+#include "stats.h"
+#include "touchpaint.h"
+
+#define MAX_SLOTS 10
+#define SLOT_SEGMENTS 16
+
+struct paint_slot {
+	spinlock_t lock;
+	struct tp_segment segs[SLOT_SEGMENTS];
+	int nr_segs;
+	/* Start of the oldest touch frame with queued segments */
+	u64 frame_start_ns;
+	struct kthread_worker *worker;
+	struct kthread_work work;
+} ____cacheline_aligned_in_smp;
+
+static struct paint_slot paint_slots[MAX_SLOTS];
+static struct kthread_worker *workers[NR_CPUS];
+static struct task_struct *vsync_thread;
+static DECLARE_WAIT_QUEUE_HEAD(vsync_wq);
+static bool vsync_pending;
+
+static DEFINE_TP_STAT(slot_stat, "paint_slot");
+
+static void stamp_bounds(struct tp_rect *rect, int x, int y,
+			 const struct brush_stamp *stamp)
+{
+	const struct brush_span *span = stamp->spans;
+	const struct brush_span *end = span + stamp->nr_spans;
+
+	rect->x1 = rect->y1 = INT_MAX;
+	rect->x2 = rect->y2 = INT_MIN;
+	for (; span < end; span++) {
+		rect->x1 = min(rect->x1, x + span->x);
+		rect->x2 = max(rect->x2, x + span->x + span->len);
+		rect->y1 = min(rect->y1, y + span->dy);
+		rect->y2 = max(rect->y2, y + span->dy + 1);
+	}
+}
+
+static void add_dirty(struct tp_rect *dirty, const struct tp_rect *rect)
+{
+	if (tp_rect_empty(dirty)) {
+		*dirty = *rect;
+		return;
+	}
+
+	dirty->x1 = min(dirty->x1, rect->x1);
+	dirty->y1 = min(dirty->y1, rect->y1);
+	dirty->x2 = max(dirty->x2, rect->x2);
+	dirty->y2 = max(dirty->y2, rect->y2);
+}
+
+static void render_segments(const struct tp_segment *segs, int nr,
+			    u64 frame_start_ns)
+{
+	struct tp_rect dirty = { 0 }, rect, hud;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		const struct tp_segment *seg = &segs[i];
+		u8 r = seg->color >> 16, g = seg->color >> 8, b = seg->color;
+
+		draw_stamp(seg->x2, seg->y2, seg->stamp, r, g, b);
+		stamp_bounds(&rect, seg->x2, seg->y2, seg->stamp);
+		add_dirty(&dirty, &rect);
+
+		if (seg->x1 == seg->x2 && seg->y1 == seg->y2)
+			continue;
+
+		draw_stamp_line(seg->x2, seg->y2, seg->x1, seg->y1, seg->stamp,
+				r, g, b);
+		stamp_bounds(&rect, seg->x1, seg->y1, seg->stamp);
+		add_dirty(&dirty, &rect);
+	}
+
+	tp_fb_flush(&dirty);
+	tp_hold_note_cpu();
+
+	/* Strokes that cross the HUD need it to be redrawn */
+	tp_hud_area(&hud);
+	if (tp_rect_intersect(&rect, &dirty, &hud))
+		tp_hud_invalidate();
+
+	tp_stat_add(&slot_stat, ktime_get_ns() - frame_start_ns);
+}
+
+static void paint_work_func(struct kthread_work *work)
+{
+	struct paint_slot *ps = container_of(work, struct paint_slot, work);
+	struct tp_segment segs[SLOT_SEGMENTS];
+	unsigned long flags;
+	u64 frame_start_ns;
+	int nr;
+
+	spin_lock_irqsave(&ps->lock, flags);
+	nr = ps->nr_segs;
+	memcpy(segs, ps->segs, nr * sizeof(*segs));
+	frame_start_ns = ps->frame_start_ns;
+	ps->nr_segs = 0;
+	spin_unlock_irqrestore(&ps->lock, flags);
+
+	if (nr)
+		render_segments(segs, nr, frame_start_ns);
+}
+
+static bool can_queue(struct paint_slot *ps, enum tp_paint_render render)
+{
+	switch (render) {
+	case PAINT_PARALLEL:
+		return ps->worker;
+	case PAINT_VSYNC:
+		return vsync_thread;
+	default:
+		return false;
+	}
+}
+
+/* Called from the input callback for every touch sample */
+void tp_paint_segment(int slot, const struct tp_segment *seg,
+		      u64 frame_start_ns, enum tp_paint_render render)
+{
+	struct paint_slot *ps = &paint_slots[slot];
+	bool queued = false;
+
+	if (can_queue(ps, render)) {
+		spin_lock(&ps->lock);
+		if (ps->nr_segs < SLOT_SEGMENTS) {
+			if (!ps->nr_segs)
+				ps->frame_start_ns = frame_start_ns;
+
+			ps->segs[ps->nr_segs++] = *seg;
+			queued = true;
+		}
+		spin_unlock(&ps->lock);
+	}
+
+	/* Fall back to drawing inline if the worker can't keep up */
+	if (!queued)
+		render_segments(seg, 1, frame_start_ns);
+}
+
+/* Hands the segments queued in this touch frame to the renderers */
+void tp_paint_commit(enum tp_paint_render render)
+{
+	int i;
+
+	if (render == PAINT_VSYNC) {
+		if (vsync_thread) {
+			WRITE_ONCE(vsync_pending, true);
+			wake_up(&vsync_wq);
+		}
+
+		return;
+	}
+
+	for (i = 0; i < MAX_SLOTS; i++) {
+		struct paint_slot *ps = &paint_slots[i];
+
+		if (ps->worker && READ_ONCE(ps->nr_segs))
+			kthread_queue_work(ps->worker, &ps->work);
+	}
+}
+
+/* Renders queued segments before each vblank until a frame has none */
+static int vsync_thread_func(void *data)
+{
+	struct tp_sched sched;
+	int i;
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(vsync_wq, READ_ONCE(vsync_pending) ||
+					 kthread_should_stop());
+
+		/* Parameters are only sampled when a new stroke starts */
+		tp_sched_setup(&sched);
+		tp_vsync_get();
+		while (!kthread_should_stop()) {
+			u64 vblank = tp_vsync_wait();
+			u64 start;
+
+			if (!xchg(&vsync_pending, false))
+				break;
+
+			start = ktime_get_ns();
+			for (i = 0; i < MAX_SLOTS; i++)
+				paint_work_func(&paint_slots[i].work);
+
+			tp_sched_frame(&sched, ktime_get_ns() - start);
+			tp_vsync_frame_done(vblank);
+		}
+		tp_vsync_put();
+	}
+
+	return 0;
+}
+
+/* Creates one worker per online CPU and assigns slots to them round-robin */
+int tp_paint_init(void)
+{
+	static const struct sched_param rt_prio = { .sched_priority = 1 };
+	int nr_workers = 0;
+	int cpu, i;
+
+	for_each_online_cpu(cpu) {
+		struct kthread_worker *worker;
+
+		worker = kthread_create_worker_on_cpu(cpu, 0, "touchpaint_paint/%d",
+						      cpu);
+		if (IS_ERR(worker)) {
+			pr_err("failed to create paint worker on CPU %d! err=%ld\n",
+			       cpu, PTR_ERR(worker));
+			continue;
+		}
+
+		sched_setscheduler_nocheck(worker->task, SCHED_FIFO, &rt_prio);
+		workers[nr_workers++] = worker;
+	}
+
+	for (i = 0; i < MAX_SLOTS; i++) {
+		struct paint_slot *ps = &paint_slots[i];
+
+		spin_lock_init(&ps->lock);
+		kthread_init_work(&ps->work, paint_work_func);
+		if (nr_workers)
+			ps->worker = workers[i % nr_workers];
+	}
+
+	vsync_thread = kthread_run(vsync_thread_func, NULL, "touchpaint_vsync");
+	if (IS_ERR(vsync_thread)) {
+		pr_err("failed to start vsync paint thread! err=%ld\n",
+		       PTR_ERR(vsync_thread));
+		vsync_thread = NULL;
+	}
+
+	tp_stat_register(&slot_stat);
+	return nr_workers ? 0 : -ENOMEM;
+}
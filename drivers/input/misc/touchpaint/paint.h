@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ */
+
+#ifndef _TOUCHPAINT_PAINT_H
+#define _TOUCHPAINT_PAINT_H
+
+#include <linux/types.h>
+
+struct brush_stamp;
+
+/* Stroke from (x2, y2) back to (x1, y1), or a single point if they're equal */
+struct tp_segment {
+	int x1;
+	int y1;
+	int x2;
+	int y2;
+	const struct brush_stamp *stamp;
+	u32 color;
+};
+
+enum tp_paint_render {
+	/* Draw in the input callback */
+	PAINT_INLINE,
+	/* Draw each slot on its own per-CPU worker */
+	PAINT_PARALLEL,
+	/* Draw all slots at once, just before the next vblank */
+	PAINT_VSYNC,
+};
+
+int tp_paint_init(void);
+void tp_paint_segment(int slot, const struct tp_segment *seg,
+		      u64 frame_start_ns, enum tp_paint_render render);
+void tp_paint_commit(enum tp_paint_render render);
+
+#endif /* _TOUCHPAINT_PAINT_H */
@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Idle latency constraint while touching. Between touch scans, the CPUs
+ * handling the touch IRQ and rendering can otherwise enter deep cluster
+ * idle states and pay their exit latency on every sample. From the first
+ * finger down until idle_hold_ms after the last finger up, a CPU DMA
+ * latency request of idle_latency_us is held on only those CPUs, so the
+ * rest of the system can still idle normally.
+ *
+ * The CPUs and the hold time come from the shared touch CPU tracker, and
+ * the request follows the CPUs as they show up.
+ *
+ * The latency limit alone still allows cluster modes that exit quickly
+ * enough, and those can flush the cache of the touch CPU. With
+ * idle_cluster_hold, the same CPUs are also marked as latency-critical for
+ * lpm-levels, which caps the cluster modes of their clusters only.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/cpuidle.h>
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/pm_qos.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <soc/qcom/lpm_latency.h>
+
+#include "stats.h"
+#include "touchpaint.h"
+
+/* Idle state usage of one CPU */
+struct idle_usage {
+	u64 usage[CPUIDLE_STATE_MAX];
+	u64 time_us[CPUIDLE_STATE_MAX];
+};
+
+static struct pm_qos_request qos_req;
+static struct lpm_latency_req cluster_req;
+/* Worker only */
+static struct cpumask held_cpus;
+static bool held;
+static bool cluster_held;
+static u64 held_start_ns;
+static u64 held_total_ns;
+static unsigned int nr_holds;
+static struct idle_usage held_start[NR_CPUS];
+static struct idle_usage held_usage[NR_CPUS];
+
+static void read_idle_usage(int cpu, struct idle_usage *out)
+{
+	struct cpuidle_device *dev = per_cpu(cpuidle_devices, cpu);
+	int i;
+
+	memset(out, 0, sizeof(*out));
+	if (!dev)
+		return;
+
+	for (i = 0; i < CPUIDLE_STATE_MAX; i++) {
+		out->usage[i] = dev->states_usage[i].usage;
+		out->time_us[i] = dev->states_usage[i].time;
+	}
+}
+
+/* Accumulates idle state usage on held CPUs since the hold started */
+static void account_hold(void)
+{
+	struct idle_usage now;
+	int cpu, i;
+
+	for_each_cpu(cpu, &held_cpus) {
+		read_idle_usage(cpu, &now);
+		for (i = 0; i < CPUIDLE_STATE_MAX; i++) {
+			held_usage[cpu].usage[i] += now.usage[i] -
+						    held_start[cpu].usage[i];
+			held_usage[cpu].time_us[i] += now.time_us[i] -
+						      held_start[cpu].time_us[i];
+		}
+	}
+
+	held_total_ns += ktime_get_ns() - held_start_ns;
+}
+
+static void start_hold(void)
+{
+	int cpu;
+
+	held_start_ns = ktime_get_ns();
+	for_each_cpu(cpu, &held_cpus)
+		read_idle_usage(cpu, &held_start[cpu]);
+}
+
+static void release_clusters(void)
+{
+	if (!cluster_held)
+		return;
+
+	lpm_latency_remove_request(&cluster_req);
+	cluster_held = false;
+}
+
+static void hold_clusters(void)
+{
+	if (!READ_ONCE(tp_idle_cluster_hold)) {
+		release_clusters();
+		return;
+	}
+
+	if (cluster_held) {
+		lpm_latency_update_request(&cluster_req, &held_cpus);
+	} else {
+		lpm_latency_add_request(&cluster_req, &held_cpus, "touchpaint");
+		cluster_held = true;
+	}
+}
+
+/* Called from the timer worker when the hold time runs out */
+void tp_qos_release(void)
+{
+	if (!held)
+		return;
+
+	account_hold();
+	pm_qos_remove_request(&qos_req);
+	release_clusters();
+	held = false;
+}
+
+/* Called from the timer worker when the set of CPUs involved changes */
+void tp_qos_hold(const struct cpumask *cpus)
+{
+	int latency = READ_ONCE(tp_idle_latency_us);
+
+	/* The limit was turned off during a hold */
+	if (latency < 0) {
+		tp_qos_release();
+		return;
+	}
+
+	if (held) {
+		/* Affinity is fixed once added, so re-add with the new CPUs */
+		account_hold();
+		pm_qos_remove_request(&qos_req);
+	} else {
+		nr_holds++;
+	}
+
+	cpumask_copy(&held_cpus, cpus);
+	qos_req.type = PM_QOS_REQ_AFFINE_CORES;
+	cpumask_copy(&qos_req.cpus_affine, &held_cpus);
+	pm_qos_add_request(&qos_req, PM_QOS_CPU_DMA_LATENCY, latency);
+	hold_clusters();
+	held = true;
+	start_hold();
+}
+
+static int idle_qos_show(struct seq_file *m, void *unused)
+{
+	int cpu, i;
+
+	seq_printf(m, "latency limit: %d us, held %u times for %llu ms total%s\n",
+		   tp_idle_latency_us, nr_holds, div_u64(held_total_ns, NSEC_PER_MSEC),
+		   held ? " (held now, not yet counted)" : "");
+	seq_printf(m, "CPUs: %*pbl, cluster idle capped: %s\n\n",
+		   cpumask_pr_args(&held_cpus), cluster_held ? "yes" : "no");
+	seq_printf(m, "%-4s %-16s %10s %12s\n", "cpu", "state", "entries",
+		   "time_us");
+
+	for_each_possible_cpu(cpu) {
+		struct cpuidle_device *dev = per_cpu(cpuidle_devices, cpu);
+		struct cpuidle_driver *drv;
+
+		if (!dev)
+			continue;
+
+		drv = cpuidle_get_cpu_driver(dev);
+		if (!drv)
+			continue;
+
+		for (i = 0; i < drv->state_count; i++) {
+			if (!held_usage[cpu].usage[i])
+				continue;
+
+			seq_printf(m, "%-4d %-16s %10llu %12llu\n", cpu,
+				   drv->states[i].name, held_usage[cpu].usage[i],
+				   held_usage[cpu].time_us[i]);
+		}
+	}
+
+	return 0;
+}
+
+static int idle_qos_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, idle_qos_show, NULL);
+}
+
+static const struct file_operations idle_qos_fops = {
+	.owner		= THIS_MODULE,
+	.open		= idle_qos_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void tp_qos_debugfs_init(void)
+{
+	struct dentry *dir = tp_debugfs_dir();
+
+	if (dir)
+		debugfs_create_file("idle_qos", 0400, dir, NULL, &idle_qos_fops);
+}
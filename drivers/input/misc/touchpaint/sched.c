@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Scheduling for render threads. By default they run as SCHED_FIFO, but
+ * with render_deadline set, they run as SCHED_DEADLINE instead. Each frame
+ * period then reserves enough runtime to render one frame before the vsync
+ * budget runs out, even if there's other RT work around. The runtime starts
+ * at the whole budget and follows the measured render cost.
+ *
+ * SCHED_DEADLINE tasks can't be bound to a subset of CPUs, so per-CPU
+ * workers always use SCHED_FIFO.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/version.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 10, 0)
+#include <uapi/linux/sched/types.h>
+#endif
+
+#include "stats.h"
+#include "touchpaint.h"
+
+/* Frames to measure before adjusting the reserved runtime */
+#define DL_WINDOW_FRAMES 32
+#define DL_MIN_RUNTIME_NS (50 * NSEC_PER_USEC)
+
+/* How much render cost exceeded the reserved runtime, only counts overruns */
+static DEFINE_TP_STAT(overrun_stat, "dl_overrun");
+
+static int set_deadline(struct tp_sched *ts, u64 runtime_ns)
+{
+	struct sched_attr attr = {
+		.size = sizeof(attr),
+		.sched_policy = SCHED_DEADLINE,
+		.sched_runtime = runtime_ns,
+		.sched_deadline = ts->deadline_ns,
+		.sched_period = ts->period_ns,
+	};
+	int ret;
+
+	ret = sched_setattr(current, &attr);
+	if (!ret)
+		ts->runtime_ns = runtime_ns;
+
+	return ret;
+}
+
+void tp_sched_setup(struct tp_sched *ts)
+{
+	static const struct sched_param rt_prio = { .sched_priority = 1 };
+	unsigned int hz = clamp(tp_vsync_hz, 1U, 1000U);
+	int ret;
+
+	memset(ts, 0, sizeof(*ts));
+	if (tp_render_deadline) {
+		ts->period_ns = div_u64(NSEC_PER_SEC, hz);
+		ts->deadline_ns = clamp_t(u64, (u64)tp_vsync_budget_us * NSEC_PER_USEC,
+					  DL_MIN_RUNTIME_NS, ts->period_ns);
+
+		ret = set_deadline(ts, ts->deadline_ns);
+		if (!ret) {
+			ts->deadline = true;
+			return;
+		}
+
+		pr_warn("failed to use SCHED_DEADLINE for %s, falling back to SCHED_FIFO! err=%d\n",
+			current->comm, ret);
+	}
+
+	sched_setscheduler_nocheck(current, SCHED_FIFO, &rt_prio);
+}
+
+/* Called by the render thread after each frame */
+void tp_sched_frame(struct tp_sched *ts, u64 cost_ns)
+{
+	u64 runtime;
+
+	if (!ts->deadline)
+		return;
+
+	if (cost_ns > ts->runtime_ns)
+		tp_stat_add(&overrun_stat, cost_ns - ts->runtime_ns);
+
+	ts->window_max_ns = max(ts->window_max_ns, cost_ns);
+	if (++ts->window_frames < DL_WINDOW_FRAMES)
+		return;
+
+	/* Reserve the worst recent frame with 25% headroom */
+	runtime = clamp_t(u64, ts->window_max_ns + ts->window_max_ns / 4,
+			  DL_MIN_RUNTIME_NS, ts->deadline_ns);
+	if (runtime != ts->runtime_ns && set_deadline(ts, runtime))
+		pr_debug("failed to update SCHED_DEADLINE runtime for %s\n",
+			 current->comm);
+
+	ts->window_max_ns = 0;
+	ts->window_frames = 0;
+}
+
+void tp_sched_init(void)
+{
+	tp_stat_register(&overrun_stat);
+}
@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Scroll mode: emulates a list that follows the finger vertically. Every
+ * touch sample shifts the whole screen, which is the worst case for a real
+ * UI. Rows are shifted with memmove inside a cacheable shadow buffer, only
+ * newly exposed rows are rendered, and only rows whose contents actually
+ * changed are copied to the framebuffer.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include "draw.h"
+#include "stats.h"
+#include "touchpaint.h"
+
+#define ITEM_HEIGHT 160
+#define ICON_SIZE 112
+#define ICON_MARGIN 24
+
+static u32 *shadow;
+static size_t row_bytes;
+static int scroll_pos;
+static int touch_base_pos;
+static int touch_base_y;
+static bool drawn;
+
+static DEFINE_TP_STAT(scroll_stat, "scroll");
+
+static u32 *shadow_row(int y)
+{
+	return shadow + (size_t)y * fb_stride;
+}
+
+static u32 item_color(int item, bool icon)
+{
+	static const u32 icon_colors[] = {
+		0xffe53935, 0xff43a047, 0xff1e88e5, 0xfffdd835, 0xff8e24aa,
+	};
+
+	if (icon)
+		return icon_colors[item % ARRAY_SIZE(icon_colors)];
+
+	return item % 2 ? 0xff303030 : 0xff424242;
+}
+
+/* Renders one row of list content into the shadow buffer */
+static void render_row(int y)
+{
+	int content_y = y + scroll_pos;
+	int item = content_y >= 0 ? content_y / ITEM_HEIGHT :
+				    (content_y + 1) / ITEM_HEIGHT - 1;
+	int item_y = content_y - item * ITEM_HEIGHT;
+	u32 *row = shadow_row(y);
+	int icon_top = (ITEM_HEIGHT - ICON_SIZE) / 2;
+	int x;
+
+	if (item < 0)
+		item = -item;
+
+	/* 1-px divider between items */
+	if (item_y == ITEM_HEIGHT - 1) {
+		for (x = 0; x < fb_width; x++)
+			row[x] = 0xff000000;
+		return;
+	}
+
+	for (x = 0; x < fb_width; x++)
+		row[x] = item_color(item, false);
+
+	if (item_y >= icon_top && item_y < icon_top + ICON_SIZE) {
+		int icon_end = min(ICON_MARGIN + ICON_SIZE, fb_width);
+
+		for (x = ICON_MARGIN; x < icon_end; x++)
+			row[x] = item_color(item, true);
+	}
+}
+
+static void flush_rows(int start, int end)
+{
+	if (start >= end)
+		return;
+
+	memcpy_toio(fb_mem + (size_t)start * fb_stride, shadow_row(start),
+		    (end - start) * row_bytes);
+	tp_fb_flush(&(struct tp_rect){ 0, start, fb_width, end });
+}
+
+static void redraw(void)
+{
+	int y;
+
+	for (y = 0; y < fb_height; y++)
+		render_row(y);
+
+	flush_rows(0, fb_height);
+	drawn = true;
+}
+
+/*
+ * Shifts the content up by delta rows (down if negative). Row y of the new
+ * frame shows what was in row y + delta before, so row y's previous contents
+ * can be found in row y - delta of the new frame when it's on screen.
+ */
+static void shift(int delta)
+{
+	int abs_delta = abs(delta);
+	int keep = fb_height - abs_delta;
+	int run_start = -1;
+	int y;
+
+	scroll_pos += delta;
+	if (abs_delta >= fb_height) {
+		redraw();
+		return;
+	}
+
+	if (delta > 0) {
+		memmove(shadow_row(0), shadow_row(delta), keep * row_bytes);
+		for (y = keep; y < fb_height; y++)
+			render_row(y);
+	} else {
+		memmove(shadow_row(abs_delta), shadow_row(0), keep * row_bytes);
+		for (y = 0; y < abs_delta; y++)
+			render_row(y);
+	}
+
+	/* Copy runs of changed rows to the framebuffer */
+	for (y = 0; y < fb_height; y++) {
+		int old_y = y - delta;
+		bool changed = old_y < 0 || old_y >= fb_height ||
+			       memcmp(shadow_row(y), shadow_row(old_y), row_bytes);
+
+		if (changed && run_start < 0) {
+			run_start = y;
+		} else if (!changed && run_start >= 0) {
+			flush_rows(run_start, y);
+			run_start = -1;
+		}
+	}
+
+	if (run_start >= 0)
+		flush_rows(run_start, fb_height);
+}
+
+void tp_scroll_reset(void)
+{
+	drawn = false;
+}
+
+void tp_scroll_touch_down(int y)
+{
+	if (!shadow)
+		return;
+
+	if (!drawn)
+		redraw();
+
+	touch_base_pos = scroll_pos;
+	touch_base_y = y;
+}
+
+void tp_scroll_touch_move(int y)
+{
+	int delta;
+	u64 start;
+
+	if (!shadow || !drawn)
+		return;
+
+	/* Content follows the finger, so moving up scrolls down the list */
+	delta = touch_base_pos - (y - touch_base_y) - scroll_pos;
+	if (!delta)
+		return;
+
+	start = ktime_get_ns();
+	shift(delta);
+	tp_stat_add(&scroll_stat, ktime_get_ns() - start);
+}
+
+int tp_scroll_init(void)
+{
+	row_bytes = (size_t)fb_stride * sizeof(u32);
+	shadow = vmalloc(row_bytes * fb_height);
+	if (!shadow)
+		return -ENOMEM;
+
+	tp_stat_register(&scroll_stat);
+	return 0;
+}
+
+void tp_scroll_free(void)
+{
+	vfree(shadow);
+	shadow = NULL;
+}
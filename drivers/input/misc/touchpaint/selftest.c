@@ -0,0 +1,485 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Self-test for the rendering primitives. Each primitive is run against a
+ * vmalloc'd fake framebuffer and the result is compared pixel-for-pixel with
+ * a naive reference implementation that clips every pixel individually.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": selftest: " fmt
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include "brush.h"
+#include "draw.h"
+#include "sprite.h"
+#include "touchpaint.h"
+
+#define TEST_WIDTH 1080
+#define TEST_HEIGHT 2340
+/* Padding catches writes past the end of a row */
+#define TEST_STRIDE (TEST_WIDTH + 8)
+#define BENCH_ITERS 32
+
+static u32 *test_mem;
+static u32 *ref_mem;
+static int failures;
+
+static size_t test_size(void)
+{
+	return (size_t)fb_stride * fb_height * sizeof(u32);
+}
+
+static u32 ref_pixel(u8 r, u8 g, u8 b)
+{
+	return 0xff000000 | (r << 16) | (g << 8) | b;
+}
+
+static void ref_rect(int x, int y, int w, int h, u32 pixel)
+{
+	int cur_x, cur_y;
+
+	for (cur_y = y; cur_y < y + h; cur_y++) {
+		if (cur_y < 0 || cur_y >= fb_height)
+			continue;
+
+		for (cur_x = x; cur_x < x + w; cur_x++) {
+			if (cur_x < 0 || cur_x >= fb_width)
+				continue;
+
+			ref_mem[cur_x + (size_t)cur_y * fb_stride] = pixel;
+		}
+	}
+}
+
+static void ref_point(int x, int y, int size, u32 pixel)
+{
+	int radius = max(1, (size - 1) / 2);
+
+	ref_rect(x - radius, y - radius, size, size, pixel);
+}
+
+/* Pixel centers inside the circle inscribed in the square brush */
+static void ref_round(int x, int y, int size, u32 pixel)
+{
+	int radius = max(1, (size - 1) / 2);
+	int i, j;
+
+	for (i = 0; i < size; i++) {
+		for (j = 0; j < size; j++) {
+			int dx2 = 2 * j + 1 - size, dy2 = 2 * i + 1 - size;
+
+			if (dx2 * dx2 + dy2 * dy2 <= size * size)
+				ref_rect(x - radius + j, y - radius + i, 1, 1, pixel);
+		}
+	}
+}
+
+static void ref_line(int x1, int y1, int x2, int y2, int size, u32 pixel)
+{
+	int dx = abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+	int dy = abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+	int err = (dx > dy ? dx : -dy) / 2;
+	int err2;
+
+	while (true) {
+		ref_point(x1, y1, size, pixel);
+
+		if (x1 == x2 && y1 == y2)
+			break;
+
+		err2 = err;
+		if (err2 > -dx) {
+			err -= dy;
+			x1 += sx;
+		}
+
+		if (err2 < dy) {
+			err += dx;
+			y1 += sy;
+		}
+	}
+}
+
+static void reset(void)
+{
+	memset(test_mem, 0, test_size());
+	memset(ref_mem, 0, test_size());
+}
+
+static void check(const char *name, int arg1, int arg2, int arg3)
+{
+	size_t i, count = (size_t)fb_stride * fb_height;
+
+	for (i = 0; i < count; i++) {
+		if (test_mem[i] == ref_mem[i])
+			continue;
+
+		pr_err("%s(%d, %d, %d): mismatch at (%zu, %zu): got %08x, expected %08x\n",
+		       name, arg1, arg2, arg3, i % fb_stride, i / fb_stride,
+		       test_mem[i], ref_mem[i]);
+		failures++;
+		return;
+	}
+}
+
+static void test_pixels(void)
+{
+	static const int counts[] = { 0, 1, 2, 3, 4, 5 };
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(counts); i++) {
+		int count = counts[i];
+		int expected = count >= 2 ? 2 : count;
+		int ret;
+
+#if defined(CONFIG_ARCH_SUPPORTS_INT128) && defined(__SIZEOF_INT128__)
+		if (count >= 4)
+			expected = 4;
+#endif
+
+		reset();
+		ret = draw_pixels(100, 200, count, 12, 34, 56);
+		ref_rect(100, 200, expected, 1, ref_pixel(12, 34, 56));
+		check("draw_pixels", 100, 200, count);
+
+		if (ret != expected) {
+			pr_err("draw_pixels(count=%d) returned %d, expected %d\n",
+			       count, ret, expected);
+			failures++;
+		}
+	}
+}
+
+static void test_h_line(void)
+{
+	const int cases[][3] = {
+		{ 0, 0, 1 },
+		{ 5, 10, 3 },
+		{ 7, 50, 0 },
+		{ 0, 40, fb_width },
+		{ fb_width - 5, 20, 10 },
+		{ -5, 30, 10 },
+		{ 100, -1, 10 },
+		{ 100, fb_height, 10 },
+		{ 0, fb_height - 1, fb_width + 10 },
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		int x = cases[i][0], y = cases[i][1], len = cases[i][2];
+
+		reset();
+		draw_h_line(x, y, len, 255, 255, 255);
+		ref_rect(x, y, len, 1, ref_pixel(255, 255, 255));
+		check("draw_h_line", x, y, len);
+	}
+}
+
+static void test_point(void)
+{
+	static const int sizes[] = { 1, 2, 3, 5, 8, 301 };
+	const int points[][2] = {
+		{ fb_width / 2, fb_height / 2 },
+		{ 0, 0 },
+		{ 3, fb_height - 2 },
+		{ fb_width - 1, fb_height - 1 },
+		{ -10, -10 },
+		{ fb_width + 5, 100 },
+		{ 100, fb_height + 5 },
+	};
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		for (j = 0; j < ARRAY_SIZE(points); j++) {
+			int x = points[j][0], y = points[j][1];
+
+			reset();
+			draw_point(x, y, sizes[i], 255, 255, 0);
+			ref_point(x, y, sizes[i], ref_pixel(255, 255, 0));
+			check("draw_point", x, y, sizes[i]);
+		}
+	}
+}
+
+static void test_stamp(void)
+{
+	static const int sizes[] = { 1, 2, 3, 4, 9, 32, BRUSH_MAX_SIZE };
+	const int points[][2] = {
+		{ fb_width / 2, fb_height / 2 },
+		{ 0, 0 },
+		{ fb_width - 1, fb_height - 1 },
+	};
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		for (j = 0; j < ARRAY_SIZE(points); j++) {
+			int x = points[j][0], y = points[j][1];
+
+			reset();
+			draw_stamp(x, y, brush_get_stamp(BRUSH_SQUARE, sizes[i]),
+				   255, 255, 0);
+			ref_point(x, y, sizes[i], ref_pixel(255, 255, 0));
+			check("draw_stamp/square", x, y, sizes[i]);
+
+			reset();
+			draw_stamp(x, y, brush_get_stamp(BRUSH_ROUND, sizes[i]),
+				   255, 255, 0);
+			ref_round(x, y, sizes[i], ref_pixel(255, 255, 0));
+			check("draw_stamp/round", x, y, sizes[i]);
+		}
+	}
+}
+
+static void test_line(void)
+{
+	static const int sizes[] = { 1, 2, 9 };
+	const int lines[][4] = {
+		{ 100, 100, 900, 2000 },
+		{ 900, 100, 100, 100 },
+		{ fb_width / 2, 0, fb_width / 2, fb_height - 1 },
+		{ 0, fb_height - 1, fb_width - 1, 0 },
+		{ -20, 50, 50, -20 },
+		{ fb_width - 10, fb_height - 10, fb_width + 20, fb_height + 60 },
+		{ 5, 5, 5, 5 },
+	};
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		for (j = 0; j < ARRAY_SIZE(lines); j++) {
+			const int *l = lines[j];
+
+			reset();
+			draw_line(l[0], l[1], l[2], l[3], sizes[i], 255, 255, 255);
+			ref_line(l[0], l[1], l[2], l[3], sizes[i],
+				 ref_pixel(255, 255, 255));
+			check("draw_line", l[0], l[1], sizes[i]);
+		}
+	}
+}
+
+static void ref_pattern(u32 *mem)
+{
+	size_t i, count = (size_t)fb_stride * fb_height;
+
+	for (i = 0; i < count; i++)
+		mem[i] = i * 2654435761u;
+}
+
+static void test_sprite(void)
+{
+	const int moves[][2] = {
+		{ 300, 300 }, { 310, 300 }, { 310, 290 }, { 295, 310 },
+		{ 700, 1500 }, { 0, 0 }, { -100, 40 }, { 60, -20 },
+		{ fb_width - 1, fb_height / 2 }, { fb_width + 400, 0 },
+		{ fb_width / 2, fb_height - 1 },
+	};
+	static const int sizes[] = { 301, 2, 51 };
+	u32 fg = ref_pixel(255, 255, 255);
+	struct tp_sprite sprite;
+	int i, j;
+
+	if (tp_sprite_init(&sprite, 301, 301, 255, 255, 255)) {
+		pr_err("failed to allocate sprite\n");
+		failures++;
+		return;
+	}
+
+	/* Every move must leave the background intact outside the sprite */
+	ref_pattern(test_mem);
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		tp_sprite_resize(&sprite, sizes[i], sizes[i]);
+
+		for (j = 0; j < ARRAY_SIZE(moves); j++) {
+			int x = moves[j][0], y = moves[j][1];
+
+			tp_sprite_move(&sprite, x, y);
+			ref_pattern(ref_mem);
+			ref_point(x, y, sizes[i], fg);
+			check("tp_sprite_move", x, y, sizes[i]);
+		}
+
+		tp_sprite_hide(&sprite);
+		ref_pattern(ref_mem);
+		check("tp_sprite_hide", 0, 0, sizes[i]);
+		cond_resched();
+	}
+
+	tp_sprite_free(&sprite);
+}
+
+static void test_fill(void)
+{
+	reset();
+	fill_screen(64, 0, 128);
+	ref_rect(0, 0, fb_width, fb_height, ref_pixel(64, 0, 128));
+	check("fill_screen", 64, 0, 128);
+}
+
+static void test_vert_damage(void)
+{
+	static const int sizes[] = { 2, 51, 301 };
+	static const int steps[] = { 1, -1, 7, -7, 400, -400 };
+	const int starts[] = { 10, fb_height / 2, fb_height - 10 };
+	u32 fg = ref_pixel(255, 255, 0), bg = ref_pixel(64, 0, 128);
+	int i, j, k;
+
+	/* Damage rendering must match a full redraw at the new position */
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		for (j = 0; j < ARRAY_SIZE(starts); j++) {
+			for (k = 0; k < ARRAY_SIZE(steps); k++) {
+				int x = fb_width / 2, size = sizes[i];
+				int y1 = starts[j], y2 = y1 + steps[k];
+
+				reset();
+				fill_screen(64, 0, 128);
+				draw_point(x, y1, size, 255, 255, 0);
+				draw_vert_point_damage(size, x, y1, y2,
+						       255, 255, 0, 64, 0, 128);
+
+				ref_rect(0, 0, fb_width, fb_height, bg);
+				ref_point(x, y2, size, fg);
+				check("draw_vert_point_damage", size, y1, y2);
+			}
+		}
+
+		cond_resched();
+	}
+}
+
+static void bench(const char *name, int arg, int iters,
+		  void (*fn)(int arg))
+{
+	u64 min_ns = U64_MAX, total_ns = 0;
+	int i;
+
+	fn(arg);
+	for (i = 0; i < iters; i++) {
+		u64 start = ktime_get_ns();
+		u64 delta;
+
+		fn(arg);
+		delta = ktime_get_ns() - start;
+		total_ns += delta;
+		min_ns = min(min_ns, delta);
+	}
+
+	pr_info("%-24s %4d: min %llu ns, avg %llu ns\n", name, arg, min_ns,
+		div_u64(total_ns, iters));
+}
+
+static void bench_pixels(int count)
+{
+	draw_pixels(fb_width / 2, fb_height / 2, count, 255, 255, 255);
+}
+
+static void bench_h_line(int length)
+{
+	draw_h_line(0, fb_height / 2, length, 255, 255, 255);
+}
+
+static void bench_point(int size)
+{
+	draw_point(fb_width / 2, fb_height / 2, size, 255, 255, 255);
+}
+
+static void bench_round(int size)
+{
+	draw_stamp(fb_width / 2, fb_height / 2,
+		   brush_get_stamp(BRUSH_ROUND, size), 255, 255, 255);
+}
+
+static void bench_line(int size)
+{
+	draw_line(0, 0, fb_width - 1, fb_height / 2, size, 255, 255, 255);
+}
+
+static void bench_fill(int unused)
+{
+	fill_screen(64, 0, 128);
+}
+
+static void bench_vert_damage(int size)
+{
+	static int step = 7;
+	static int y;
+
+	if (!y)
+		y = fb_height / 2;
+
+	draw_vert_point_damage(size, fb_width / 2, y, y + step,
+			       255, 255, 0, 64, 0, 128);
+	y += step;
+	if (y > fb_height / 2 + 100 || y < fb_height / 2 - 100)
+		step *= -1;
+}
+
+static void run_benchmarks(void)
+{
+	bench("draw_pixels", 4, BENCH_ITERS, bench_pixels);
+	bench("draw_h_line", fb_width, BENCH_ITERS, bench_h_line);
+	bench("draw_point", 2, BENCH_ITERS, bench_point);
+	bench("draw_point", 9, BENCH_ITERS, bench_point);
+	bench("draw_point", 32, BENCH_ITERS, bench_point);
+	bench("draw_point", 301, BENCH_ITERS, bench_point);
+	bench("draw_stamp/round", 9, BENCH_ITERS, bench_round);
+	bench("draw_stamp/round", 32, BENCH_ITERS, bench_round);
+	bench("draw_line", 2, BENCH_ITERS, bench_line);
+	bench("draw_line", 9, BENCH_ITERS, bench_line);
+	bench("draw_vert_point_damage", 301, BENCH_ITERS, bench_vert_damage);
+	bench("fill_screen", 0, 4, bench_fill);
+}
+
+int touchpaint_selftest(void)
+{
+	u32 __iomem *saved_mem = fb_mem;
+	int saved_width = fb_width;
+	int saved_height = fb_height;
+	int saved_stride = fb_stride;
+
+	fb_width = TEST_WIDTH;
+	fb_height = TEST_HEIGHT;
+	fb_stride = TEST_STRIDE;
+	failures = 0;
+
+	test_mem = vmalloc(test_size());
+	ref_mem = vmalloc(test_size());
+	if (!test_mem || !ref_mem) {
+		pr_err("failed to allocate fake framebuffers\n");
+		failures = -ENOMEM;
+		goto out;
+	}
+
+	fb_mem = (u32 __force __iomem *)test_mem;
+
+	test_pixels();
+	test_h_line();
+	test_point();
+	test_stamp();
+	test_line();
+	test_sprite();
+	test_fill();
+	test_vert_damage();
+
+	if (failures)
+		pr_err("%d checks failed\n", failures);
+	else
+		pr_info("all rendering checks passed\n");
+
+	run_benchmarks();
+
+out:
+	vfree(ref_mem);
+	vfree(test_mem);
+	fb_mem = saved_mem;
+	fb_width = saved_width;
+	fb_height = saved_height;
+	fb_stride = saved_stride;
+
+	return failures;
+}
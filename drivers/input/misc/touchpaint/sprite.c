@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Sprites with save-under. Before a sprite is drawn, the pixels under it are
+ * copied into a cacheable buffer so they can be restored when it moves.
+ *
+ * Saved pixels are stored at (x mod w, y mod h) rather than relative to the
+ * sprite, so pixels that stay covered keep their slot when the sprite moves.
+ * Only the strips that were exposed or newly covered need to be copied, and
+ * the slots freed by restoring exposed strips are exactly the ones needed to
+ * save the newly covered strips.
+ *
+ * Overlapping sprites must be hidden in the reverse order they were shown,
+ * otherwise one sprite's saved pixels will include another sprite.
+ */
+
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/vmalloc.h>
+
+#include "sprite.h"
+#include "touchpaint.h"
+
+static const struct tp_rect empty_rect;
+
+static struct tp_rect clip_rect(int x, int y, int w, int h)
+{
+	struct tp_rect rect = {
+		.x1 = max(x, 0),
+		.y1 = max(y, 0),
+		.x2 = min(x + w, fb_width),
+		.y2 = min(y + h, fb_height),
+	};
+
+	return rect;
+}
+
+static void copy_strip(struct tp_sprite *sprite, const struct tp_rect *rect,
+		       bool save)
+{
+	int y;
+
+	for (y = rect->y1; y < rect->y2; y++) {
+		u32 *row = sprite->save + (y % sprite->h) * sprite->w;
+		u32 __iomem *fb_row = fb_mem + (size_t)y * fb_stride;
+		int x = rect->x1;
+
+		/* Each strip row wraps around the buffer at most once */
+		while (x < rect->x2) {
+			int slot = x % sprite->w;
+			int len = min(rect->x2 - x, sprite->w - slot);
+
+			if (save)
+				memcpy_fromio(row + slot, fb_row + x, len * sizeof(u32));
+			else
+				memcpy_toio(fb_row + x, row + slot, len * sizeof(u32));
+
+			x += len;
+		}
+	}
+}
+
+/* Moves the sprite so that it's centered the same way as draw_point() */
+void tp_sprite_move(struct tp_sprite *sprite, int x, int y)
+{
+	int x_radius = max(1, (sprite->w - 1) / 2);
+	int y_radius = max(1, (sprite->h - 1) / 2);
+	struct tp_rect area, strips[4];
+	int i, nr;
+
+	if (!sprite->save)
+		return;
+
+	area = clip_rect(x - x_radius, y - y_radius, sprite->w, sprite->h);
+
+	/* Restore pixels that are no longer covered */
+	nr = tp_rect_subtract(strips, &sprite->area, &area);
+	for (i = 0; i < nr; i++) {
+		copy_strip(sprite, &strips[i], false);
+		tp_fb_flush(&strips[i]);
+	}
+
+	/* Save and draw over newly covered pixels */
+	nr = tp_rect_subtract(strips, &area, &sprite->area);
+	for (i = 0; i < nr; i++) {
+		copy_strip(sprite, &strips[i], true);
+		draw_rect(&strips[i], sprite->r, sprite->g, sprite->b);
+		tp_fb_flush(&strips[i]);
+	}
+
+	sprite->area = area;
+}
+
+void tp_sprite_hide(struct tp_sprite *sprite)
+{
+	if (!sprite->save || !tp_sprite_visible(sprite))
+		return;
+
+	copy_strip(sprite, &sprite->area, false);
+	tp_fb_flush(&sprite->area);
+	sprite->area = empty_rect;
+}
+
+/* Forgets saved pixels after the screen was redrawn behind the sprite */
+void tp_sprite_reset(struct tp_sprite *sprite)
+{
+	sprite->area = empty_rect;
+}
+
+/* Only takes effect while hidden, clamped to the size given at init */
+void tp_sprite_resize(struct tp_sprite *sprite, int w, int h)
+{
+	if (tp_sprite_visible(sprite))
+		return;
+
+	sprite->w = clamp(w, 1, sprite->max_w);
+	sprite->h = clamp(h, 1, sprite->max_h);
+}
+
+int tp_sprite_init(struct tp_sprite *sprite, int max_w, int max_h,
+		   u8 r, u8 g, u8 b)
+{
+	sprite->save = vmalloc((size_t)max_w * max_h * sizeof(u32));
+	if (!sprite->save)
+		return -ENOMEM;
+
+	sprite->w = sprite->max_w = max_w;
+	sprite->h = sprite->max_h = max_h;
+	sprite->r = r;
+	sprite->g = g;
+	sprite->b = b;
+	sprite->area = empty_rect;
+
+	return 0;
+}
+
+void tp_sprite_free(struct tp_sprite *sprite)
+{
+	vfree(sprite->save);
+	sprite->save = NULL;
+}
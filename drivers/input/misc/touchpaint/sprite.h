@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ */
+
+#ifndef _TOUCHPAINT_SPRITE_H
+#define _TOUCHPAINT_SPRITE_H
+
+#include "draw.h"
+
+/* Solid rectangle that restores the pixels it covered when it moves away */
+struct tp_sprite {
+	int w;
+	int h;
+	int max_w;
+	int max_h;
+	u8 r;
+	u8 g;
+	u8 b;
+	/* On-screen area currently covered, empty if hidden */
+	struct tp_rect area;
+	/* Save-under buffer, max_w * max_h pixels */
+	u32 *save;
+};
+
+int tp_sprite_init(struct tp_sprite *sprite, int max_w, int max_h,
+		   u8 r, u8 g, u8 b);
+void tp_sprite_free(struct tp_sprite *sprite);
+void tp_sprite_resize(struct tp_sprite *sprite, int w, int h);
+void tp_sprite_move(struct tp_sprite *sprite, int x, int y);
+void tp_sprite_hide(struct tp_sprite *sprite);
+void tp_sprite_reset(struct tp_sprite *sprite);
+
+static inline bool tp_sprite_visible(const struct tp_sprite *sprite)
+{
+	return !tp_rect_empty(&sprite->area);
+}
+
+#endif /* _TOUCHPAINT_SPRITE_H */
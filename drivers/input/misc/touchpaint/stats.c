@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Latency statistics exported through debugfs. Each stat keeps a
+ * log-linear histogram so percentiles can be reported without storing
+ * individual samples.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include "stats.h"
+
+static LIST_HEAD(stat_list);
+static DEFINE_MUTEX(stat_list_lock);
+static struct dentry *debugfs_dir;
+
+static unsigned int ns_to_bucket(u64 ns)
+{
+	u64 val = ns >> 10;
+	unsigned int msb;
+	unsigned int idx;
+
+	if (val < (1 << TP_STAT_SUB_BITS))
+		return val;
+
+	msb = fls64(val) - 1;
+	idx = ((msb - TP_STAT_SUB_BITS + 1) << TP_STAT_SUB_BITS) +
+	      ((val >> (msb - TP_STAT_SUB_BITS)) & ((1 << TP_STAT_SUB_BITS) - 1));
+
+	return min_t(unsigned int, idx, TP_STAT_BUCKETS - 1);
+}
+
+/* Returns the exclusive upper bound of the given bucket */
+static u64 bucket_to_ns(unsigned int idx)
+{
+	unsigned int shift, sub;
+
+	idx++;
+	if (idx < (1 << TP_STAT_SUB_BITS))
+		return (u64)idx << 10;
+
+	shift = (idx >> TP_STAT_SUB_BITS) - 1;
+	sub = idx & ((1 << TP_STAT_SUB_BITS) - 1);
+
+	return ((u64)((1 << TP_STAT_SUB_BITS) + sub) << shift) << 10;
+}
+
+void tp_stat_register(struct tp_stat *stat)
+{
+	mutex_lock(&stat_list_lock);
+	if (list_empty(&stat->node))
+		list_add_tail(&stat->node, &stat_list);
+	mutex_unlock(&stat_list_lock);
+}
+
+void tp_stat_add(struct tp_stat *stat, u64 ns)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&stat->lock, flags);
+	stat->count++;
+	stat->total_ns += ns;
+	stat->last_ns = ns;
+	stat->min_ns = min(stat->min_ns, ns);
+	stat->max_ns = max(stat->max_ns, ns);
+	stat->buckets[ns_to_bucket(ns)]++;
+	spin_unlock_irqrestore(&stat->lock, flags);
+}
+
+static u64 __tp_stat_percentile(struct tp_stat *stat, unsigned int pct)
+{
+	u64 target, seen = 0;
+	unsigned int i;
+
+	if (!stat->count)
+		return 0;
+
+	target = DIV_ROUND_UP_ULL(stat->count * pct, 100);
+	for (i = 0; i < TP_STAT_BUCKETS; i++) {
+		seen += stat->buckets[i];
+		if (seen >= target)
+			return clamp(bucket_to_ns(i), stat->min_ns, stat->max_ns);
+	}
+
+	return stat->max_ns;
+}
+
+u64 tp_stat_percentile(struct tp_stat *stat, unsigned int pct)
+{
+	unsigned long flags;
+	u64 ret;
+
+	spin_lock_irqsave(&stat->lock, flags);
+	ret = __tp_stat_percentile(stat, pct);
+	spin_unlock_irqrestore(&stat->lock, flags);
+
+	return ret;
+}
+
+void tp_stat_reset(struct tp_stat *stat)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&stat->lock, flags);
+	stat->count = 0;
+	stat->total_ns = 0;
+	stat->min_ns = U64_MAX;
+	stat->max_ns = 0;
+	stat->last_ns = 0;
+	memset(stat->buckets, 0, sizeof(stat->buckets));
+	spin_unlock_irqrestore(&stat->lock, flags);
+}
+
+static int stats_show(struct seq_file *m, void *unused)
+{
+	struct tp_stat *stat;
+
+	seq_printf(m, "%-20s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+		   "name", "count", "last_ns", "min_ns", "avg_ns", "p50_ns",
+		   "p90_ns", "p99_ns", "max_ns");
+
+	mutex_lock(&stat_list_lock);
+	list_for_each_entry(stat, &stat_list, node) {
+		unsigned long flags;
+		u64 p50, p90, p99, avg;
+
+		spin_lock_irqsave(&stat->lock, flags);
+		p50 = __tp_stat_percentile(stat, 50);
+		p90 = __tp_stat_percentile(stat, 90);
+		p99 = __tp_stat_percentile(stat, 99);
+		avg = stat->count ? div64_u64(stat->total_ns, stat->count) : 0;
+
+		seq_printf(m, "%-20s %10llu %10llu %10llu %10llu %10llu %10llu %10llu %10llu\n",
+			   stat->name, stat->count, stat->last_ns,
+			   stat->count ? stat->min_ns : 0, avg, p50, p90, p99,
+			   stat->max_ns);
+		spin_unlock_irqrestore(&stat->lock, flags);
+	}
+	mutex_unlock(&stat_list_lock);
+
+	return 0;
+}
+
+static int stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, stats_show, NULL);
+}
+
+/* Writing anything to the file resets all stats */
+static ssize_t stats_write(struct file *file, const char __user *buf,
+			   size_t count, loff_t *ppos)
+{
+	struct tp_stat *stat;
+
+	mutex_lock(&stat_list_lock);
+	list_for_each_entry(stat, &stat_list, node)
+		tp_stat_reset(stat);
+	mutex_unlock(&stat_list_lock);
+
+	return count;
+}
+
+static const struct file_operations stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= stats_open,
+	.read		= seq_read,
+	.write		= stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* Directory for other debugfs files, NULL if debugfs is unavailable */
+struct dentry *tp_debugfs_dir(void)
+{
+	return debugfs_dir;
+}
+
+int tp_stats_init(void)
+{
+	debugfs_dir = debugfs_create_dir(KBUILD_MODNAME, NULL);
+	if (IS_ERR_OR_NULL(debugfs_dir)) {
+		debugfs_dir = NULL;
+		return -ENODEV;
+	}
+
+	if (!debugfs_create_file("stats", 0644, debugfs_dir, NULL, &stats_fops))
+		return -ENOMEM;
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ */
+
+#ifndef _TOUCHPAINT_STATS_H
+#define _TOUCHPAINT_STATS_H
+
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+struct dentry;
+
+/* Log-linear buckets: 8 per power of two, in units of 1024 ns */
+#define TP_STAT_SUB_BITS 3
+#define TP_STAT_BUCKETS 184
+
+struct tp_stat {
+	const char *name;
+	spinlock_t lock;
+	struct list_head node;
+
+	u64 count;
+	u64 total_ns;
+	u64 min_ns;
+	u64 max_ns;
+	u64 last_ns;
+	u32 buckets[TP_STAT_BUCKETS];
+};
+
+#define DEFINE_TP_STAT(_var, _name)					\
+	struct tp_stat _var = {						\
+		.name = _name,						\
+		.lock = __SPIN_LOCK_UNLOCKED(_var.lock),		\
+		.node = LIST_HEAD_INIT(_var.node),			\
+		.min_ns = U64_MAX,					\
+	}
+
+void tp_stat_register(struct tp_stat *stat);
+void tp_stat_add(struct tp_stat *stat, u64 ns);
+u64 tp_stat_percentile(struct tp_stat *stat, unsigned int pct);
+void tp_stat_reset(struct tp_stat *stat);
+int tp_stats_init(void);
+struct dentry *tp_debugfs_dir(void);
+
+#endif /* _TOUCHPAINT_STATS_H */
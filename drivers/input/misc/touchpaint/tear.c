@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Tearing visualization mode: every touch sample redraws the whole screen
+ * with vertical bars whose phase follows the finger. The screen is written
+ * top to bottom in bands, the same order the display scans it out, so any
+ * tear shows up as a consistent horizontal break in the bars.
+ *
+ * Since every row is identical, only one row is rendered. It's replicated
+ * into a cacheable band buffer by repeated doubling and each band is then
+ * written to the framebuffer with a single sequential copy.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include "draw.h"
+#include "stats.h"
+#include "touchpaint.h"
+
+#define TEAR_BAR_WIDTH 64
+#define TEAR_BAND_ROWS 32
+
+static u32 *band;
+static size_t row_bytes;
+
+static DEFINE_TP_STAT(tear_stat, "tear");
+
+static void render_row(u32 *row, int phase)
+{
+	int x;
+
+	for (x = 0; x < fb_width; x++) {
+		int pos = (x - phase) % (TEAR_BAR_WIDTH * 2);
+
+		if (pos < 0)
+			pos += TEAR_BAR_WIDTH * 2;
+
+		row[x] = pos < TEAR_BAR_WIDTH ? 0xffffffff : 0xff000000;
+	}
+}
+
+/* Copies the first row to the rest of the band, doubling each time */
+static void replicate_row(int nr_rows)
+{
+	int done = 1;
+
+	while (done < nr_rows) {
+		int count = min(done, nr_rows - done);
+
+		memcpy(band + (size_t)done * fb_stride, band, count * row_bytes);
+		done += count;
+	}
+}
+
+void tp_tear_render(int x)
+{
+	int rows = min(fb_height, TEAR_BAND_ROWS);
+	u64 start;
+	int y;
+
+	if (!band)
+		return;
+
+	start = ktime_get_ns();
+	render_row(band, x);
+	replicate_row(rows);
+
+	for (y = 0; y < fb_height; y += rows) {
+		int count = min(rows, fb_height - y);
+
+		memcpy_toio(fb_mem + (size_t)y * fb_stride, band, count * row_bytes);
+	}
+	tp_fb_flush_all();
+
+	tp_stat_add(&tear_stat, ktime_get_ns() - start);
+}
+
+int tp_tear_init(void)
+{
+	row_bytes = (size_t)fb_stride * sizeof(u32);
+	band = vmalloc(row_bytes * TEAR_BAND_ROWS);
+	if (!band)
+		return -ENOMEM;
+
+	tp_stat_register(&tear_stat);
+	return 0;
+}
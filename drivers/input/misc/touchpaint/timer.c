@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Deferred work with sub-millisecond precision. Timer wheel timers only
+ * have jiffy resolution (10 ms at HZ=100) and run in softirq context, which
+ * is no place for clearing a 10 MB framebuffer. Instead, each tp_timer is an
+ * hrtimer that only queues its callback on a SCHED_FIFO kthread worker.
+ * Callbacks run in process context, one at a time, in the order they
+ * expired.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/err.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/version.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 10, 0)
+#include <uapi/linux/sched/types.h>
+#endif
+
+#include "stats.h"
+#include "timer.h"
+
+static struct kthread_worker *timer_worker;
+
+/* How late callbacks ran relative to their expiry time */
+static DEFINE_TP_STAT(late_stat, "timer_late");
+
+static void timer_work_func(struct kthread_work *work)
+{
+	struct tp_timer *timer = container_of(work, struct tp_timer, work);
+	u64 now = ktime_get_ns();
+	unsigned long flags;
+	bool fire;
+
+	/* The timer may have been cancelled or restarted after it expired */
+	spin_lock_irqsave(&timer->lock, flags);
+	fire = timer->armed && now >= timer->expires_ns;
+	if (fire)
+		timer->armed = false;
+	spin_unlock_irqrestore(&timer->lock, flags);
+
+	if (!fire)
+		return;
+
+	tp_stat_add(&late_stat, now - timer->expires_ns);
+	timer->fn(timer);
+}
+
+static enum hrtimer_restart timer_func(struct hrtimer *hrtimer)
+{
+	struct tp_timer *timer = container_of(hrtimer, struct tp_timer, hrtimer);
+
+	kthread_queue_work(timer_worker, &timer->work);
+	return HRTIMER_NORESTART;
+}
+
+void tp_timer_init(struct tp_timer *timer, void (*fn)(struct tp_timer *timer))
+{
+	hrtimer_init(&timer->hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	timer->hrtimer.function = timer_func;
+	kthread_init_work(&timer->work, timer_work_func);
+	spin_lock_init(&timer->lock);
+	timer->armed = false;
+	timer->fn = fn;
+}
+
+/* (Re)starts the timer, safe to call from atomic context */
+void tp_timer_start(struct tp_timer *timer, u64 delay_ns)
+{
+	unsigned long flags;
+
+	if (!timer_worker)
+		return;
+
+	spin_lock_irqsave(&timer->lock, flags);
+	timer->armed = true;
+	timer->expires_ns = ktime_get_ns() + delay_ns;
+	spin_unlock_irqrestore(&timer->lock, flags);
+
+	/* No point in waking up twice */
+	if (!delay_ns) {
+		hrtimer_try_to_cancel(&timer->hrtimer);
+		kthread_queue_work(timer_worker, &timer->work);
+		return;
+	}
+
+	hrtimer_start(&timer->hrtimer, ns_to_ktime(delay_ns), HRTIMER_MODE_REL);
+}
+
+/* Safe to call from atomic context, doesn't wait for a running callback */
+void tp_timer_cancel(struct tp_timer *timer)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&timer->lock, flags);
+	timer->armed = false;
+	spin_unlock_irqrestore(&timer->lock, flags);
+
+	hrtimer_try_to_cancel(&timer->hrtimer);
+}
+
+bool tp_timer_pending(struct tp_timer *timer)
+{
+	return READ_ONCE(timer->armed);
+}
+
+int tp_timers_init(void)
+{
+	static const struct sched_param rt_prio = { .sched_priority = 1 };
+
+	timer_worker = kthread_create_worker(0, "touchpaint_timer");
+	if (IS_ERR(timer_worker)) {
+		int ret = PTR_ERR(timer_worker);
+
+		timer_worker = NULL;
+		return ret;
+	}
+
+	sched_setscheduler_nocheck(timer_worker->task, SCHED_FIFO, &rt_prio);
+	tp_stat_register(&late_stat);
+	return 0;
+}
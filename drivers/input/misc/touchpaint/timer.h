@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ */
+
+#ifndef _TOUCHPAINT_TIMER_H
+#define _TOUCHPAINT_TIMER_H
+
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+/* Callback that runs on the RT timer worker after a high-resolution delay */
+struct tp_timer {
+	struct hrtimer hrtimer;
+	struct kthread_work work;
+	spinlock_t lock;
+	bool armed;
+	u64 expires_ns;
+	void (*fn)(struct tp_timer *timer);
+};
+
+int tp_timers_init(void);
+void tp_timer_init(struct tp_timer *timer, void (*fn)(struct tp_timer *timer));
+void tp_timer_start(struct tp_timer *timer, u64 delay_ns);
+void tp_timer_cancel(struct tp_timer *timer);
+bool tp_timer_pending(struct tp_timer *timer);
+
+#endif /* _TOUCHPAINT_TIMER_H */
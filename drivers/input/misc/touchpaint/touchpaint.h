@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ */
+
+#ifndef _TOUCHPAINT_H
+#define _TOUCHPAINT_H
+
+#include <linux/types.h>
+
+struct cpumask;
+struct tp_rect;
+struct tp_stat;
+
+/* Framebuffer description, fields are 0 or NULL when unknown */
+struct tp_fb_info {
+	phys_addr_t base;
+	size_t size;
+	int width;
+	int height;
+	/* Bytes per row */
+	int pitch;
+	const char *format;
+};
+
+bool tp_fb_info_from_dt(struct tp_fb_info *info);
+
+/* Framebuffer mapping */
+enum tp_fb_map {
+	FB_MAP_WC,
+	FB_MAP_WT,
+	FB_MAP_WB,
+	FB_MAP_MAX
+};
+
+extern bool tp_fb_bench_running;
+
+int tp_fb_map(phys_addr_t phys, size_t size, enum tp_fb_map type,
+	      bool blocks);
+void tp_fb_unmap(void);
+void tp_fb_flush(const struct tp_rect *rect);
+void tp_fb_flush_all(void);
+void tp_fb_bench_init(void);
+
+/* Balls mode */
+void tp_balls_init(void);
+void tp_balls_start(int count, int size, int speed, bool ramp_up);
+void tp_balls_frame(u64 now_ns);
+
+/* Latency HUD */
+void tp_hud_init(void);
+void tp_hud_invalidate(void);
+void tp_hud_area(struct tp_rect *rect);
+void tp_hud_update(struct tp_stat *render, unsigned int sample_hz,
+		   const char *mode_name);
+
+/* Idle latency constraint */
+extern int tp_idle_latency_us;
+extern int tp_idle_hold_ms;
+extern bool tp_idle_cluster_hold;
+
+void tp_qos_debugfs_init(void);
+void tp_qos_hold(const struct cpumask *cpus);
+void tp_qos_release(void);
+
+/* CPU frequency floor */
+extern int tp_freq_floor_pct;
+
+void tp_freq_init(void);
+void tp_freq_debugfs_init(void);
+void tp_freq_hold(const struct cpumask *cpus);
+void tp_freq_release(void);
+void tp_freq_add_render(u64 ns);
+
+/* CPUs involved in the current touch, for both of the above */
+void tp_hold_init(void);
+void tp_hold_touch_down(void);
+void tp_hold_touch_up(void);
+void tp_hold_note_cpu(void);
+
+/* Scroll mode */
+int tp_scroll_init(void);
+void tp_scroll_free(void);
+void tp_scroll_reset(void);
+void tp_scroll_touch_down(int y);
+void tp_scroll_touch_move(int y);
+
+/* Tearing mode */
+int tp_tear_init(void);
+void tp_tear_render(int x);
+
+/* Vsync pacing */
+extern unsigned int tp_vsync_hz;
+extern int tp_vsync_phase_us;
+extern unsigned int tp_vsync_budget_us;
+
+void tp_vsync_init(void);
+void tp_vsync_signal(u64 vblank_ns);
+void tp_vsync_get(void);
+void tp_vsync_put(void);
+u64 tp_vsync_wait(void);
+void tp_vsync_frame_done(u64 vblank_ns);
+
+/* Render thread scheduling */
+extern bool tp_render_deadline;
+
+struct tp_sched {
+	bool deadline;
+	u64 runtime_ns;
+	u64 deadline_ns;
+	u64 period_ns;
+	/* Worst render cost in the current measurement window */
+	u64 window_max_ns;
+	unsigned int window_frames;
+};
+
+void tp_sched_init(void);
+void tp_sched_setup(struct tp_sched *ts);
+void tp_sched_frame(struct tp_sched *ts, u64 cost_ns);
+
+#ifdef CONFIG_TOUCHPAINT_SELFTEST
+int touchpaint_selftest(void);
+#else
+static inline int touchpaint_selftest(void)
+{
+	return 0;
+}
+#endif
+
+#endif /* _TOUCHPAINT_H */
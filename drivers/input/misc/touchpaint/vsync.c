@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2020 Danny Lin <danny@kdrag0n.dev>
+ *
+ * Vsync pacing. A vsync source reports vblank timestamps, and renderers
+ * sleep until the predicted next vblank minus their render budget so that
+ * each frame is ready just before it's scanned out.
+ *
+ * The only source for now is a software one: an hrtimer that fires at
+ * vsync_hz, offset by vsync_phase_us from CLOCK_MONOTONIC. A source backed
+ * by a display driver's vblank interrupt only needs to call
+ * tp_vsync_signal() with each vblank timestamp.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/hrtimer.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+
+#include "stats.h"
+#include "touchpaint.h"
+
+struct tp_vsync_source {
+	const char *name;
+	void (*start)(u64 period_ns, u64 phase_ns);
+	void (*stop)(void);
+};
+
+static DEFINE_MUTEX(vsync_lock);
+static unsigned int vsync_users;
+static u64 period_ns;
+static u64 last_vblank_ns;
+
+/* How late renderers woke up relative to vblank - budget */
+static DEFINE_TP_STAT(wake_stat, "vsync_wake");
+/* How late frames finished relative to their vblank, only counts misses */
+static DEFINE_TP_STAT(miss_stat, "vsync_miss");
+
+/* Records a vblank, called by the active vsync source */
+void tp_vsync_signal(u64 vblank_ns)
+{
+	WRITE_ONCE(last_vblank_ns, vblank_ns);
+}
+
+static struct hrtimer sw_timer;
+
+static enum hrtimer_restart sw_timer_func(struct hrtimer *timer)
+{
+	tp_vsync_signal(ktime_to_ns(hrtimer_get_expires(timer)));
+	hrtimer_forward_now(timer, ns_to_ktime(period_ns));
+
+	return HRTIMER_RESTART;
+}
+
+/* Vblanks happen at phase + k * period */
+static void sw_start(u64 period, u64 phase)
+{
+	u64 now = ktime_get_ns();
+	u64 prev;
+
+	div64_u64_rem(now + period - phase, period, &prev);
+	prev = now - prev;
+
+	tp_vsync_signal(prev);
+	hrtimer_start(&sw_timer, ns_to_ktime(prev + period), HRTIMER_MODE_ABS);
+}
+
+static void sw_stop(void)
+{
+	hrtimer_cancel(&sw_timer);
+}
+
+static const struct tp_vsync_source sw_source = {
+	.name = "software",
+	.start = sw_start,
+	.stop = sw_stop,
+};
+
+static const struct tp_vsync_source *source = &sw_source;
+
+/* Starts the vsync source for a new user, process context only */
+void tp_vsync_get(void)
+{
+	mutex_lock(&vsync_lock);
+	if (!vsync_users++) {
+		unsigned int hz = clamp(tp_vsync_hz, 1U, 1000U);
+		int phase_us = clamp_t(int, tp_vsync_phase_us, 0, USEC_PER_SEC / hz - 1);
+
+		period_ns = div_u64(NSEC_PER_SEC, hz);
+		source->start(period_ns, (u64)phase_us * NSEC_PER_USEC);
+		pr_debug("started %s vsync source at %u Hz\n", source->name, hz);
+	}
+	mutex_unlock(&vsync_lock);
+}
+
+void tp_vsync_put(void)
+{
+	mutex_lock(&vsync_lock);
+	if (!--vsync_users)
+		source->stop();
+	mutex_unlock(&vsync_lock);
+}
+
+/* Returns the first vblank at or after the given time */
+static u64 next_vblank(u64 ns)
+{
+	u64 base = READ_ONCE(last_vblank_ns);
+
+	if (ns <= base)
+		return base;
+
+	return base + div64_u64(ns - base + period_ns - 1, period_ns) * period_ns;
+}
+
+/*
+ * Sleeps until vsync_budget_us before the next vblank that can still be
+ * made, and returns the time of that vblank. Must be called between
+ * tp_vsync_get() and tp_vsync_put().
+ */
+u64 tp_vsync_wait(void)
+{
+	u64 budget = (u64)tp_vsync_budget_us * NSEC_PER_USEC;
+	u64 vblank = next_vblank(ktime_get_ns() + budget);
+	ktime_t wake = ns_to_ktime(vblank - budget);
+
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&wake, HRTIMER_MODE_ABS);
+	tp_stat_add(&wake_stat, max_t(s64, ktime_get_ns() - ktime_to_ns(wake), 0));
+
+	return vblank;
+}
+
+/* Called after rendering the frame for the given vblank */
+void tp_vsync_frame_done(u64 vblank_ns)
+{
+	u64 now = ktime_get_ns();
+
+	if (now > vblank_ns)
+		tp_stat_add(&miss_stat, now - vblank_ns);
+}
+
+void tp_vsync_init(void)
+{
+	hrtimer_init(&sw_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	sw_timer.function = sw_timer_func;
+
+	tp_stat_register(&wake_stat);
+	tp_stat_register(&miss_stat);
+}
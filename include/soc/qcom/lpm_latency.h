@@ -0,0 +1,43 @@
+/* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __SOC_QCOM_LPM_LATENCY_H__
+#define __SOC_QCOM_LPM_LATENCY_H__
+
+#include <linux/cpumask.h>
+#include <linux/list.h>
+
+/*
+ * While a request is held, cluster low power modes of clusters containing
+ * any of its CPUs are capped at the lpm_latency_cluster_level parameter.
+ */
+struct lpm_latency_req {
+	struct list_head list;
+	struct cpumask cpus;
+	const char *name;
+};
+
+#ifdef CONFIG_MSM_PM
+void lpm_latency_add_request(struct lpm_latency_req *req,
+		const struct cpumask *cpus, const char *name);
+void lpm_latency_update_request(struct lpm_latency_req *req,
+		const struct cpumask *cpus);
+void lpm_latency_remove_request(struct lpm_latency_req *req);
+#else
+static inline void lpm_latency_add_request(struct lpm_latency_req *req,
+		const struct cpumask *cpus, const char *name) { }
+static inline void lpm_latency_update_request(struct lpm_latency_req *req,
+		const struct cpumask *cpus) { }
+static inline void lpm_latency_remove_request(struct lpm_latency_req *req) { }
+#endif
+
+#endif
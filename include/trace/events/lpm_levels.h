@@ -0,0 +1,56 @@
+/* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lpm_levels
+
+#if !defined(_TRACE_LPM_LEVELS_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LPM_LEVELS_H
+
+#include <linux/tracepoint.h>
+
+/* Matches enum lpm_wake_source in drivers/cpuidle/lpm-predict.h */
+#define show_wake_source(source)		\
+	__print_symbolic(source,		\
+		{ 0, "none" },			\
+		{ 1, "irq" },			\
+		{ 2, "ipi" },			\
+		{ 3, "timer" })
+
+TRACE_EVENT(cpu_idle_wake,
+
+	TP_PROTO(int index, u32 residency_us, int source, int irq),
+
+	TP_ARGS(index, residency_us, source, irq),
+
+	TP_STRUCT__entry(
+		__field(int, index)
+		__field(u32, residency_us)
+		__field(int, source)
+		__field(int, irq)
+	),
+
+	TP_fast_assign(
+		__entry->index = index;
+		__entry->residency_us = residency_us;
+		__entry->source = source;
+		__entry->irq = irq;
+	),
+
+	TP_printk("idx:%d residency:%u source:%s irq:%d",
+		__entry->index, __entry->residency_us,
+		show_wake_source(__entry->source), __entry->irq)
+);
+
+#endif /* _TRACE_LPM_LEVELS_H */
+
+#include <trace/define_trace.h>
@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Minimal subset of the kernel's helpers needed to build the lpm-levels
+ * prediction code in userspace.
+ */
+#ifndef _TOOLS_LPM_SIM_LINUX_KERNEL_H
+#define _TOOLS_LPM_SIM_LINUX_KERNEL_H
+
+#include <limits.h>
+
+#include <linux/types.h>
+
+#define U32_MAX ((u32)~0U)
+
+#define __maybe_unused __attribute__((unused))
+
+#define min(x, y) ({				\
+	typeof(x) _min1 = (x);			\
+	typeof(y) _min2 = (y);			\
+	_min1 < _min2 ? _min1 : _min2; })
+
+#define max(x, y) ({				\
+	typeof(x) _max1 = (x);			\
+	typeof(y) _max2 = (y);			\
+	_max1 > _max2 ? _max1 : _max2; })
+
+#define min_t(type, x, y) min((type)(x), (type)(y))
+#define max_t(type, x, y) max((type)(x), (type)(y))
+#define clamp_t(type, val, lo, hi) min_t(type, max_t(type, val, lo), hi)
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static inline unsigned long int_sqrt(unsigned long x)
+{
+	unsigned long r = 0, bit = 1UL << (sizeof(long) * 8 - 2);
+
+	while (bit > x)
+		bit >>= 2;
+
+	while (bit) {
+		if (x >= r + bit) {
+			x -= r + bit;
+			r = (r >> 1) + bit;
+		} else {
+			r >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return r;
+}
+
+#endif /* _TOOLS_LPM_SIM_LINUX_KERNEL_H */
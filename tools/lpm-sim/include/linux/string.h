@@ -0,0 +1,7 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _TOOLS_LPM_SIM_LINUX_STRING_H
+#define _TOOLS_LPM_SIM_LINUX_STRING_H
+
+#include <string.h>
+
+#endif /* _TOOLS_LPM_SIM_LINUX_STRING_H */
@@ -0,0 +1,640 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Replays idle traces through the lpm-levels CPU level selection and
+ * prediction code in drivers/cpuidle/lpm-predict.h with different policies.
+ *
+ * Traces are the text output of ftrace with these events enabled:
+ *
+ *   msm_low_power/cpu_power_select	sleep length, QoS and next event timer
+ *   msm_low_power/cpu_idle_enter		idle entry time
+ *   msm_low_power/cpu_idle_exit		actual wake time
+ *   irq/irq_handler_entry		wake IRQ, and arrivals for the
+ *					periodic detector
+ *   ipi/ipi_entry			IPI wakes
+ *
+ * lpm_levels/cpu_idle_wake can be used for the wake source instead of the
+ * first IRQ or IPI after each exit.
+ *
+ * The levels file describes the CPU levels, shallowest first, one per line
+ * (blank lines and '#' comments ignored):
+ *
+ *   <name> <entry_latency_us> <exit_latency_us> <min_residency_us> <power>
+ *
+ * Power is relative, e.g. mW, and the max residency of each level is the
+ * min residency of the next one like lpm-levels-of.c computes it. Energy is
+ * estimated as the power of each level times its residency, plus the active
+ * power during entry and exit.
+ *
+ * Only CPU levels are simulated. Cluster levels depend on the votes of other
+ * CPUs and RPM state, which the trace doesn't capture. IPI prediction and
+ * the histtimer aren't modeled either.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lpm-predict.h"
+
+#define MAX_CPUS	16
+#define MAX_LEVELS	LPM_HISTORY_MODES
+
+struct idle {
+	u64 entry_ns;
+	u64 exit_ns;
+	u32 sleep_us;
+	u32 latency_us;
+	u32 next_event_us;
+	enum lpm_wake_source wake;
+	int irq;
+};
+
+/* An idle period or an IRQ handled by the CPU, in trace order */
+struct event {
+	u64 time_ns;
+	int irq;
+	struct idle idle;
+};
+
+struct cpu_trace {
+	struct event *events;
+	size_t nr;
+	size_t cap;
+
+	/* Parser state */
+	struct idle cur;
+	bool selected;
+	bool entered;
+	/* Index of the idle event waiting for its wake source, or -1 */
+	ssize_t waking;
+};
+
+enum policy {
+	POLICY_NONE,
+	POLICY_HISTORY,
+	POLICY_PERIODIC,
+	POLICY_PREWAKE,
+	POLICY_ORACLE,
+	NR_POLICIES,
+};
+
+static const char * const policy_names[] = {
+	[POLICY_NONE]		= "none",
+	[POLICY_HISTORY]	= "history",
+	[POLICY_PERIODIC]	= "periodic",
+	[POLICY_PREWAKE]	= "prewake",
+	[POLICY_ORACLE]		= "oracle",
+};
+
+struct result {
+	double energy;
+	u64 idles;
+	u64 time_us[MAX_LEVELS];
+	u64 premature;
+	u64 shallow;
+	u64 touch_wakes;
+	u64 touch_lat_us;
+	u32 touch_lat_max;
+	struct lpm_periodic periodic;
+	struct lpm_prewake prewake;
+};
+
+struct sim_cpu {
+	struct lpm_select sel;
+	struct lpm_ring history;
+	struct lpm_periodic periodic;
+	struct lpm_prewake prewake;
+};
+
+static struct cpu_trace cpus[MAX_CPUS];
+static struct lpm_level_pwr levels[MAX_LEVELS];
+static char level_names[MAX_LEVELS][32];
+static u32 entry_latency[MAX_LEVELS];
+static double level_power[MAX_LEVELS];
+static int nlevels;
+
+static double active_power = 100;
+static u32 history_depth = 5;
+static u32 ref_stddev = 100;
+static u32 ref_premature_cnt = 1;
+static u32 tolerance_us = 200;
+static u32 margin_us = 100;
+static int touch_irq = -1;
+
+static void *grow(void *array, size_t *cap, size_t size)
+{
+	*cap = *cap ? *cap * 2 : 1024;
+	array = realloc(array, *cap * size);
+	if (!array) {
+		perror("realloc");
+		exit(1);
+	}
+
+	return array;
+}
+
+static struct event *add_event(struct cpu_trace *ct, u64 time_ns, int irq)
+{
+	struct event *ev;
+
+	if (ct->nr == ct->cap)
+		ct->events = grow(ct->events, &ct->cap, sizeof(*ct->events));
+
+	ev = &ct->events[ct->nr++];
+	memset(ev, 0, sizeof(*ev));
+	ev->time_ns = time_ns;
+	ev->irq = irq;
+	return ev;
+}
+
+static void set_wake(struct cpu_trace *ct, enum lpm_wake_source wake,
+		     int irq)
+{
+	if (ct->waking < 0)
+		return;
+
+	ct->events[ct->waking].idle.wake = wake;
+	ct->events[ct->waking].idle.irq = irq;
+	ct->waking = -1;
+}
+
+static void parse_event(struct cpu_trace *ct, u64 time_ns, const char *name,
+			const char *fields)
+{
+	struct event *ev;
+	char irq_name[64], source[16];
+	u32 residency_us;
+	int idx, irq, i;
+
+	if (!strcmp(name, "cpu_power_select")) {
+		set_wake(ct, LPM_WAKE_NONE, -1);
+		memset(&ct->cur, 0, sizeof(ct->cur));
+		ct->selected = sscanf(fields,
+				"idx:%d sleep_time:%u latency:%u next_event:%u",
+				&idx, &ct->cur.sleep_us, &ct->cur.latency_us,
+				&ct->cur.next_event_us) == 4;
+		ct->entered = false;
+	} else if (!strcmp(name, "cpu_idle_enter")) {
+		if (ct->selected) {
+			ct->cur.entry_ns = time_ns;
+			ct->entered = true;
+		}
+	} else if (!strcmp(name, "cpu_idle_exit")) {
+		if (!ct->entered)
+			return;
+
+		ct->cur.exit_ns = time_ns;
+		ev = add_event(ct, ct->cur.entry_ns, -1);
+		ev->idle = ct->cur;
+		ct->waking = ct->nr - 1;
+		ct->selected = ct->entered = false;
+	} else if (!strcmp(name, "irq_handler_entry")) {
+		if (sscanf(fields, "irq=%d name=%63s", &irq, irq_name) != 2)
+			return;
+
+		/* Per-CPU timers are covered by the sleep length */
+		if (!strcmp(irq_name, "arch_timer")) {
+			set_wake(ct, LPM_WAKE_TIMER, irq);
+			return;
+		}
+
+		set_wake(ct, LPM_WAKE_IRQ, irq);
+		add_event(ct, time_ns, irq);
+	} else if (!strcmp(name, "ipi_entry")) {
+		set_wake(ct, LPM_WAKE_IPI, -1);
+	} else if (!strcmp(name, "cpu_idle_wake")) {
+		if (sscanf(fields, "idx:%d residency:%u source:%15s irq:%d",
+			   &idx, &residency_us, source, &irq) != 4)
+			return;
+
+		for (i = 0; i < LPM_WAKE_MAX; i++) {
+			if (!strcmp(source, lpm_wake_names[i]))
+				set_wake(ct, i, irq);
+		}
+	}
+}
+
+/*
+ * Parses a line like:
+ *   <idle>-0     [002] d..2  1234.567890: cpu_idle_enter: idx:1
+ * where the flags column is optional.
+ */
+static void parse_line(char *line)
+{
+	char *p, *end, *name, *fields;
+	unsigned long sec, usec;
+	int cpu;
+
+	p = strchr(line, '[');
+	if (!p)
+		return;
+
+	cpu = strtol(p + 1, &end, 10);
+	if (*end != ']' || cpu < 0 || cpu >= MAX_CPUS)
+		return;
+
+	/* The timestamp is the first token ending with ':' */
+	for (p = end + 1; *p; p = end) {
+		p += strspn(p, " ");
+		end = p + strcspn(p, " ");
+		if (end > p && end[-1] == ':')
+			break;
+	}
+
+	if (sscanf(p, "%lu.%lu:", &sec, &usec) != 2)
+		return;
+
+	name = end + strspn(end, " ");
+	fields = strchr(name, ':');
+	if (!fields)
+		return;
+
+	*fields++ = '\0';
+	fields += strspn(fields, " ");
+	fields[strcspn(fields, "\n")] = '\0';
+	parse_event(&cpus[cpu], (sec * 1000000 + usec) * NSEC_PER_USEC, name,
+		    fields);
+}
+
+static void load_trace(const char *path)
+{
+	char line[512];
+	FILE *f;
+	int cpu;
+
+	for (cpu = 0; cpu < MAX_CPUS; cpu++)
+		cpus[cpu].waking = -1;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+
+	while (fgets(line, sizeof(line), f))
+		parse_line(line);
+
+	fclose(f);
+}
+
+static void load_levels(const char *path)
+{
+	char line[256];
+	FILE *f;
+	int i;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		struct lpm_level_pwr *pwr = &levels[nlevels];
+
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		if (nlevels == MAX_LEVELS) {
+			fprintf(stderr, "too many levels, max %d\n", MAX_LEVELS);
+			exit(1);
+		}
+
+		if (sscanf(line, "%31s %u %u %u %lf", level_names[nlevels],
+			   &entry_latency[nlevels], &pwr->exit_latency,
+			   &pwr->min_residency, &level_power[nlevels]) != 5) {
+			fprintf(stderr, "invalid level line: %s", line);
+			exit(1);
+		}
+
+		nlevels++;
+	}
+
+	fclose(f);
+
+	if (!nlevels) {
+		fprintf(stderr, "no levels in %s\n", path);
+		exit(1);
+	}
+
+	for (i = 0; i < nlevels; i++)
+		levels[i].max_residency = i + 1 < nlevels ?
+					  levels[i + 1].min_residency : U32_MAX;
+}
+
+/* Picks the IRQ that woke CPUs most often */
+static int find_touch_irq(void)
+{
+	static u64 wakes[1024];
+	int cpu, irq, best = -1;
+	size_t i;
+
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+		for (i = 0; i < cpus[cpu].nr; i++) {
+			struct idle *idle = &cpus[cpu].events[i].idle;
+
+			if (cpus[cpu].events[i].irq < 0 && idle->wake == LPM_WAKE_IRQ &&
+			    idle->irq >= 0 && idle->irq < (int)ARRAY_SIZE(wakes))
+				wakes[idle->irq]++;
+		}
+	}
+
+	for (irq = 0; irq < (int)ARRAY_SIZE(wakes); irq++) {
+		if (wakes[irq] && (best < 0 || wakes[irq] > wakes[best]))
+			best = irq;
+	}
+
+	return best;
+}
+
+static uint64_t sim_predict(struct lpm_select *sel)
+{
+	struct sim_cpu *sc = (struct sim_cpu *)sel;
+	uint64_t avg;
+
+	if (!lpm_ring_full(&sc->history))
+		return 0;
+
+	avg = lpm_ring_deviation(&sc->history, ref_stddev);
+	if (avg)
+		return avg;
+
+	lpm_ring_restrict(&sc->history, levels, nlevels, ref_premature_cnt,
+			  &sel->idx_restrict, &sel->idx_restrict_time);
+	return 0;
+}
+
+/* Deepest level that fits the QoS constraint and the actual residency */
+static int oracle_level(const struct idle *idle, u32 residency_us)
+{
+	int i, best = 0;
+
+	for (i = 1; i < nlevels; i++) {
+		if (idle->latency_us <= levels[i].exit_latency)
+			break;
+
+		if (levels[i].min_residency <= residency_us)
+			best = i;
+	}
+
+	return best;
+}
+
+static void account(struct result *res, int level, u64 residency_us,
+		    bool premature_ok)
+{
+	res->energy += level_power[level] * residency_us +
+		       active_power * (entry_latency[level] +
+				       levels[level].exit_latency);
+	res->time_us[level] += residency_us;
+	if (!premature_ok && level && residency_us < levels[level].min_residency)
+		res->premature++;
+}
+
+static void replay_idle(struct sim_cpu *sc, enum policy policy,
+			const struct idle *idle, struct result *res)
+{
+	u64 residency_us = (idle->exit_ns - idle->entry_ns) / NSEC_PER_USEC;
+	u64 periodic_ns = 0, delay_ns = 0;
+	int level, woke_level, periodic_irq = -1;
+	bool premature;
+
+	memset(&sc->sel, 0, sizeof(sc->sel));
+	sc->sel.levels = levels;
+	sc->sel.nlevels = nlevels;
+	sc->sel.latency_us = idle->latency_us;
+	sc->sel.sleep_us = idle->sleep_us;
+	sc->sel.next_event_us = idle->next_event_us;
+	sc->sel.predict = policy != POLICY_NONE;
+	sc->sel.predictor = sim_predict;
+
+	if (policy == POLICY_PERIODIC || policy == POLICY_PREWAKE) {
+		periodic_ns = lpm_periodic_predict(&sc->periodic,
+						   idle->entry_ns,
+						   &periodic_irq);
+		if (periodic_ns)
+			sc->sel.periodic_us = max_t(u32,
+					periodic_ns / NSEC_PER_USEC, 1);
+	}
+
+	if (policy == POLICY_PREWAKE)
+		sc->sel.periodic_guard_us = margin_us;
+
+	if (policy == POLICY_ORACLE) {
+		level = oracle_level(idle, residency_us);
+	} else {
+		lpm_select_level(&sc->sel);
+		level = sc->sel.best_level;
+	}
+
+	if (sc->sel.periodic_predicted)
+		lpm_periodic_expect(&sc->periodic, periodic_irq,
+				    idle->entry_ns + periodic_ns);
+
+	if (policy == POLICY_PREWAKE && sc->sel.periodic_predicted && level)
+		delay_ns = lpm_prewake_arm(&sc->prewake, periodic_irq,
+				idle->entry_ns, idle->entry_ns + periodic_ns,
+				(u64)(levels[level].exit_latency + margin_us) *
+				NSEC_PER_USEC,
+				(u64)levels[level].min_residency *
+				NSEC_PER_USEC);
+
+	res->idles++;
+	woke_level = level;
+	if (delay_ns && idle->entry_ns + delay_ns < idle->exit_ns) {
+		/* Woken by the pre-wake timer, then waits in the first level */
+		lpm_prewake_fired(&sc->prewake, idle->entry_ns + delay_ns);
+		account(res, level, delay_ns / NSEC_PER_USEC, false);
+		account(res, 0, residency_us - delay_ns / NSEC_PER_USEC, false);
+		premature = delay_ns / NSEC_PER_USEC <
+			    levels[level].min_residency;
+		lpm_ring_push(&sc->history, delay_ns / NSEC_PER_USEC, level,
+			      premature);
+		lpm_ring_push(&sc->history, residency_us - delay_ns /
+			      NSEC_PER_USEC, 0, false);
+		woke_level = 0;
+	} else {
+		if (delay_ns)
+			lpm_prewake_exit(&sc->prewake);
+
+		account(res, level, residency_us, false);
+		premature = level && residency_us < levels[level].min_residency;
+		lpm_ring_push(&sc->history, residency_us, level, premature);
+	}
+
+	if (level < oracle_level(idle, residency_us))
+		res->shallow++;
+
+	if (idle->wake == LPM_WAKE_IRQ && idle->irq == touch_irq) {
+		u32 lat = levels[woke_level].exit_latency;
+
+		res->touch_wakes++;
+		res->touch_lat_us += lat;
+		res->touch_lat_max = max(res->touch_lat_max, lat);
+	}
+}
+
+static void add_stats(struct result *res, struct sim_cpu *sc)
+{
+	res->periodic.predictions += sc->periodic.predictions;
+	res->periodic.hits += sc->periodic.hits;
+	res->periodic.early += sc->periodic.early;
+	res->periodic.late += sc->periodic.late;
+	res->periodic.missed += sc->periodic.missed;
+	res->prewake.armed += sc->prewake.armed;
+	res->prewake.on_time += sc->prewake.on_time;
+	res->prewake.early += sc->prewake.early;
+	res->prewake.late += sc->prewake.late;
+}
+
+static void replay(enum policy policy, struct result *res)
+{
+	u64 tolerance_ns = (u64)tolerance_us * NSEC_PER_USEC;
+	struct sim_cpu sc;
+	int cpu;
+	size_t i;
+
+	memset(res, 0, sizeof(*res));
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+		struct cpu_trace *ct = &cpus[cpu];
+
+		memset(&sc, 0, sizeof(sc));
+		lpm_ring_init(&sc.history, history_depth);
+		lpm_periodic_init(&sc.periodic);
+		lpm_prewake_init(&sc.prewake);
+
+		for (i = 0; i < ct->nr; i++) {
+			struct event *ev = &ct->events[i];
+
+			if (ev->irq < 0) {
+				replay_idle(&sc, policy, &ev->idle, res);
+				continue;
+			}
+
+			lpm_periodic_irq(&sc.periodic, ev->irq, ev->time_ns,
+					 tolerance_ns);
+			lpm_prewake_irq(&sc.prewake, ev->irq, ev->time_ns,
+					tolerance_ns);
+		}
+
+		add_stats(res, &sc);
+	}
+}
+
+static void print_result(enum policy policy, struct result *res,
+			 struct result *base)
+{
+	u64 total_us = 0, deep_us;
+	int i;
+
+	for (i = 0; i < nlevels; i++)
+		total_us += res->time_us[i];
+	deep_us = total_us - res->time_us[0];
+
+	printf("%-9s %10.0f %+7.1f%% %6.1f%% %8.1f%% %8.1f%% %7llu %7.1f %5u",
+	       policy_names[policy], res->energy / 1000,
+	       base->energy ? (res->energy / base->energy - 1) * 100 : 0,
+	       total_us ? 100.0 * deep_us / total_us : 0,
+	       res->idles ? 100.0 * res->premature / res->idles : 0,
+	       res->idles ? 100.0 * res->shallow / res->idles : 0,
+	       (unsigned long long)res->touch_wakes,
+	       res->touch_wakes ? (double)res->touch_lat_us / res->touch_wakes : 0,
+	       res->touch_lat_max);
+
+	if (policy == POLICY_PERIODIC || policy == POLICY_PREWAKE)
+		printf("  periodic %llu/%llu/%llu/%llu/%llu",
+		       (unsigned long long)res->periodic.predictions,
+		       (unsigned long long)res->periodic.hits,
+		       (unsigned long long)res->periodic.early,
+		       (unsigned long long)res->periodic.late,
+		       (unsigned long long)res->periodic.missed);
+
+	if (policy == POLICY_PREWAKE)
+		printf("  prewake %llu/%llu/%llu/%llu",
+		       (unsigned long long)res->prewake.armed,
+		       (unsigned long long)res->prewake.on_time,
+		       (unsigned long long)res->prewake.early,
+		       (unsigned long long)res->prewake.late);
+
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct result results[NR_POLICIES];
+	u64 idles = 0;
+	int opt, cpu, i;
+
+	while ((opt = getopt(argc, argv, "a:d:m:p:s:t:T:")) != -1) {
+		switch (opt) {
+		case 'a':
+			active_power = atof(optarg);
+			break;
+		case 'd':
+			history_depth = atoi(optarg);
+			break;
+		case 'm':
+			margin_us = atoi(optarg);
+			break;
+		case 'p':
+			ref_premature_cnt = atoi(optarg);
+			break;
+		case 's':
+			ref_stddev = atoi(optarg);
+			break;
+		case 't':
+			touch_irq = atoi(optarg);
+			break;
+		case 'T':
+			tolerance_us = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (optind != argc - 2)
+		goto usage;
+
+	load_levels(argv[optind]);
+	load_trace(argv[optind + 1]);
+
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+		for (i = 0; i < (int)cpus[cpu].nr; i++)
+			idles += cpus[cpu].events[i].irq < 0;
+	}
+
+	if (!idles) {
+		fprintf(stderr, "no idle periods in %s\n", argv[optind + 1]);
+		return 1;
+	}
+
+	if (touch_irq < 0)
+		touch_irq = find_touch_irq();
+
+	printf("%llu idle periods, %d levels, touch IRQ %d\n\n",
+	       (unsigned long long)idles, nlevels, touch_irq);
+	printf("%-9s %10s %8s %7s %9s %9s %7s %7s %5s\n", "policy", "energy",
+	       "vs none", "deep", "premature", "shallow", "touch", "lat_us",
+	       "max");
+
+	for (i = 0; i < NR_POLICIES; i++) {
+		replay(i, &results[i]);
+		print_result(i, &results[i], &results[POLICY_NONE]);
+	}
+
+	printf("\nenergy: level power * residency + active power * transitions, /1000\n");
+	printf("periodic: predictions/hits/early/late/missed\n");
+	printf("prewake: armed/on time/early/late\n");
+	return 0;
+
+usage:
+	fprintf(stderr,
+		"usage: %s [-a active_power] [-d history_depth] [-m prewake_margin_us]\n"
+		"       [-p ref_premature_cnt] [-s ref_stddev] [-t touch_irq]\n"
+		"       [-T periodic_tolerance_us] levels trace\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Userspace microbenchmark for the Touchpaint rendering core.
+ *
+ * Every primitive is timed against a malloc'd framebuffer with the same
+ * dimensions as the device, so changes to the drawing code can be measured
+ * on any Linux machine.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+
+#include <linux/kernel.h>
+
+#include "brush.h"
+#include "draw.h"
+#include "font.h"
+
+u32 *fb_mem;
+int fb_width = 1080;
+int fb_height = 2340;
+int fb_stride;
+
+static int iterations = 200;
+
+struct bench_result {
+	u64 min_ns;
+	u64 med_ns;
+	u64 mean_ns;
+};
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a;
+	u64 y = *(const u64 *)b;
+
+	return (x > y) - (x < y);
+}
+
+typedef void (*bench_fn)(int arg);
+
+static void run(const char *name, int arg, bench_fn fn, int reps)
+{
+	u64 *samples = calloc(iterations, sizeof(*samples));
+	struct bench_result res = { 0 };
+	u64 total = 0;
+	int i, j;
+
+	if (!samples) {
+		perror("calloc");
+		exit(1);
+	}
+
+	/* Warm up caches and page tables */
+	fn(arg);
+
+	for (i = 0; i < iterations; i++) {
+		u64 start = now_ns();
+
+		for (j = 0; j < reps; j++)
+			fn(arg);
+
+		samples[i] = (now_ns() - start) / reps;
+		total += samples[i];
+	}
+
+	qsort(samples, iterations, sizeof(*samples), cmp_u64);
+	res.min_ns = samples[0];
+	res.med_ns = samples[iterations / 2];
+	res.mean_ns = total / iterations;
+
+	printf("%-20s %8d %12llu %12llu %12llu\n", name, arg,
+	       (unsigned long long)res.min_ns, (unsigned long long)res.med_ns,
+	       (unsigned long long)res.mean_ns);
+	free(samples);
+}
+
+static void bench_pixels(int count)
+{
+	draw_pixels(fb_width / 2, fb_height / 2, count, 255, 255, 255);
+}
+
+static void bench_h_line(int length)
+{
+	draw_h_line(0, fb_height / 2, length, 255, 255, 255);
+}
+
+static void bench_point(int size)
+{
+	draw_point(fb_width / 2, fb_height / 2, size, 255, 255, 255);
+}
+
+static void bench_round(int size)
+{
+	draw_stamp(fb_width / 2, fb_height / 2,
+		   brush_get_stamp(BRUSH_ROUND, size), 255, 255, 255);
+}
+
+static int line_brush = 2;
+
+static void bench_line(int angle)
+{
+	double rad = angle * M_PI / 180.0;
+	int len = min(fb_width, fb_height) / 2;
+	int x1 = fb_width / 2 - (int)(cos(rad) * len / 2);
+	int y1 = fb_height / 2 - (int)(sin(rad) * len / 2);
+	int x2 = fb_width / 2 + (int)(cos(rad) * len / 2);
+	int y2 = fb_height / 2 + (int)(sin(rad) * len / 2);
+
+	draw_line(x1, y1, x2, y2, line_brush, 255, 255, 255);
+}
+
+static void bench_damage(int size)
+{
+	static int step = 7;
+	static int y;
+
+	if (!y)
+		y = fb_height / 2;
+
+	/* Oscillate around the center to keep the box on screen */
+	draw_vert_point_damage(size, fb_width / 2, y, y + step,
+			       255, 255, 0, 64, 0, 128);
+	y += step;
+	if (y > fb_height / 2 + 100 || y < fb_height / 2 - 100)
+		step *= -1;
+}
+
+static void bench_glyph(int scale)
+{
+	draw_glyph(fb_width / 2, fb_height / 2, '8');
+}
+
+static void bench_fill(int unused)
+{
+	fill_screen(64, 0, 128);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [-i iterations] [-W width] [-H height]\n",
+		argv0);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	static const int pixel_counts[] = { 1, 2, 4 };
+	static const int line_lengths[] = { 16, 64, 256, 1080 };
+	static const int brush_sizes[] = { 1, 2, 3, 4, 5, 8, 9, 16, 32, 64 };
+	static const int box_sizes[] = { 51, 101, 201, 301, 601 };
+	static const int line_brushes[] = { 1, 2, 8, 32 };
+	static const int angles[] = { 0, 15, 30, 45, 60, 75, 90 };
+	char name[32];
+	size_t i, j;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "i:W:H:")) != -1) {
+		switch (opt) {
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 'W':
+			fb_width = atoi(optarg);
+			break;
+		case 'H':
+			fb_height = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (iterations <= 0 || fb_width <= 0 || fb_height <= 0)
+		usage(argv[0]);
+	fb_stride = fb_width;
+
+	fb_mem = aligned_alloc(64, (size_t)fb_width * fb_height * 4);
+	if (!fb_mem) {
+		perror("aligned_alloc");
+		return 1;
+	}
+	memset(fb_mem, 0, (size_t)fb_width * fb_height * 4);
+
+	printf("%dx%d framebuffer, %d iterations\n\n", fb_width, fb_height,
+	       iterations);
+	printf("%-20s %8s %12s %12s %12s\n", "primitive", "arg", "min ns",
+	       "median ns", "mean ns");
+
+	for (i = 0; i < ARRAY_SIZE(pixel_counts); i++)
+		run("draw_pixels", pixel_counts[i], bench_pixels, 1000);
+
+	for (i = 0; i < ARRAY_SIZE(line_lengths); i++)
+		run("draw_h_line", line_lengths[i], bench_h_line, 100);
+
+	for (i = 0; i < ARRAY_SIZE(brush_sizes); i++)
+		run("draw_point/brush", brush_sizes[i], bench_point, 100);
+
+	for (i = 0; i < ARRAY_SIZE(brush_sizes); i++)
+		run("draw_stamp/round", brush_sizes[i], bench_round, 100);
+
+	for (i = 0; i < ARRAY_SIZE(box_sizes); i++)
+		run("draw_point/box", box_sizes[i], bench_point, 1);
+
+	for (i = 0; i < ARRAY_SIZE(line_brushes); i++) {
+		line_brush = line_brushes[i];
+		snprintf(name, sizeof(name), "draw_line/b%d", line_brush);
+
+		for (j = 0; j < ARRAY_SIZE(angles); j++)
+			run(name, angles[j], bench_line, 1);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(box_sizes); i++)
+		run("vert_point_damage", box_sizes[i], bench_damage, 10);
+
+	for (i = 1; i <= FONT_MAX_SCALE; i++) {
+		font_set_style(0xffffffff, 0xff000000, i);
+		run("draw_glyph", i, bench_glyph, 100);
+	}
+
+	run("fill_screen", 0, bench_fill, 1);
+
+	free(fb_mem);
+	return 0;
+}
@@ -0,0 +1,8 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _TOOLS_TOUCHPAINT_ASM_BARRIER_H
+#define _TOOLS_TOUCHPAINT_ASM_BARRIER_H
+
+#define smp_load_acquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+#endif /* _TOOLS_TOUCHPAINT_ASM_BARRIER_H */
@@ -0,0 +1,7 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _TOOLS_TOUCHPAINT_LINUX_COMPILER_H
+#define _TOOLS_TOUCHPAINT_LINUX_COMPILER_H
+
+#define __iomem
+
+#endif /* _TOOLS_TOUCHPAINT_LINUX_COMPILER_H */
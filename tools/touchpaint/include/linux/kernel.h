@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Minimal subset of the kernel's helpers needed to build the Touchpaint
+ * rendering core in userspace.
+ */
+#ifndef _TOOLS_TOUCHPAINT_LINUX_KERNEL_H
+#define _TOOLS_TOUCHPAINT_LINUX_KERNEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+
+#ifndef KBUILD_MODNAME
+#define KBUILD_MODNAME "touchpaint"
+#endif
+
+#define min(x, y) ({				\
+	typeof(x) _min1 = (x);			\
+	typeof(y) _min2 = (y);			\
+	_min1 < _min2 ? _min1 : _min2; })
+
+#define max(x, y) ({				\
+	typeof(x) _max1 = (x);			\
+	typeof(y) _max2 = (y);			\
+	_max1 > _max2 ? _max1 : _max2; })
+
+#define clamp(val, lo, hi) min((typeof(val))max(val, lo), hi)
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
+
+static inline unsigned long int_sqrt(unsigned long x)
+{
+	unsigned long r = 0, bit = 1UL << (sizeof(long) * 8 - 2);
+
+	while (bit > x)
+		bit >>= 2;
+
+	while (bit) {
+		if (x >= r + bit) {
+			x -= r + bit;
+			r = (r >> 1) + bit;
+		} else {
+			r >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return r;
+}
+
+#ifndef pr_fmt
+#define pr_fmt(fmt) fmt
+#endif
+
+#ifdef DEBUG
+#define pr_debug(fmt, ...) fprintf(stderr, pr_fmt(fmt), ##__VA_ARGS__)
+#else
+#define pr_debug(fmt, ...) do { } while (0)
+#endif
+#define pr_info(fmt, ...) printf(pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_err(fmt, ...) fprintf(stderr, pr_fmt(fmt), ##__VA_ARGS__)
+
+#endif /* _TOOLS_TOUCHPAINT_LINUX_KERNEL_H */
@@ -0,0 +1,277 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0
+"""
+Checks the result of a Touchpaint trace replay in QEMU.
+
+The trace is converted into input events exactly like touchpaint-replay does,
+filtered the way the input core filters multitouch events, and then fed
+through a model of Touchpaint's paint mode to produce the expected
+framebuffer. The expected image is compared against the framebuffer region
+of the guest's RAM, which QEMU exposes as a shared memory backend file.
+
+The render latency stats that the guest dumps to the serial console are
+checked against the number of rendered frames and an optional p99 budget.
+"""
+
+import argparse
+import re
+import sys
+
+ABS_MT_SLOT = 0x2F
+ABS_MT_POSITION_X = 0x35
+ABS_MT_POSITION_Y = 0x36
+ABS_MT_TRACKING_ID = 0x39
+EV_SYN = 0
+EV_ABS = 3
+SYN_REPORT = 0
+MAX_SLOTS = 10
+
+
+def load_trace(path):
+    frames = []
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+
+            fields = line.split()
+            t, slot = int(fields[0]), int(fields[1])
+            sample = (slot, None) if fields[2] == "up" else \
+                (slot, (int(fields[2]), int(fields[3])))
+
+            if frames and frames[-1][0] == t:
+                frames[-1][1].append(sample)
+            else:
+                frames.append((t, [sample]))
+
+    return frames
+
+
+def trace_to_events(frames):
+    """Mirrors the event generation in replay.c"""
+    active = [False] * MAX_SLOTS
+    tracking_id = 0
+    cur_slot = 0
+
+    for _, samples in frames:
+        for slot, pos in samples:
+            if slot != cur_slot:
+                yield EV_ABS, ABS_MT_SLOT, slot
+                cur_slot = slot
+
+            if pos is None:
+                yield EV_ABS, ABS_MT_TRACKING_ID, -1
+                active[slot] = False
+                continue
+
+            if not active[slot]:
+                yield EV_ABS, ABS_MT_TRACKING_ID, tracking_id
+                tracking_id += 1
+                active[slot] = True
+
+            yield EV_ABS, ABS_MT_POSITION_X, pos[0]
+            yield EV_ABS, ABS_MT_POSITION_Y, pos[1]
+
+        yield EV_SYN, SYN_REPORT, 0
+
+
+def input_core_filter(events):
+    """
+    Models input_handle_abs_event(): duplicate values are dropped, slot
+    changes are deferred until the next multitouch value, and frames with
+    nothing but a SYN_REPORT are never passed to handlers.
+    """
+    values = [{ABS_MT_TRACKING_ID: -1} for _ in range(MAX_SLOTS)]
+    mt_slot = 0
+    dev_slot = 0
+    pending = []
+
+    for ev_type, code, value in events:
+        if ev_type == EV_SYN:
+            pending.append((ev_type, code, value))
+            if len(pending) >= 2:
+                yield from pending
+            pending = []
+            continue
+
+        if code == ABS_MT_SLOT:
+            if 0 <= value < MAX_SLOTS:
+                mt_slot = value
+            continue
+
+        if values[mt_slot].get(code, 0) == value:
+            continue
+        values[mt_slot][code] = value
+
+        if mt_slot != dev_slot:
+            dev_slot = mt_slot
+            pending.append((EV_ABS, ABS_MT_SLOT, mt_slot))
+
+        pending.append((ev_type, code, value))
+
+
+class Framebuffer:
+    def __init__(self, width, height):
+        self.width = width
+        self.height = height
+        self.mem = bytearray(width * height * 4)
+
+    def clear(self):
+        self.mem[:] = bytes(len(self.mem))
+
+    def rect(self, x, y, w, h, pixel):
+        x1, x2 = max(x, 0), min(x + w, self.width)
+        y1, y2 = max(y, 0), min(y + h, self.height)
+        if x1 >= x2:
+            return
+
+        row = pixel.to_bytes(4, "little") * (x2 - x1)
+        for cur_y in range(y1, y2):
+            off = (cur_y * self.width + x1) * 4
+            self.mem[off:off + len(row)] = row
+
+    def point(self, x, y, size, pixel):
+        radius = max(1, (size - 1) // 2)
+        self.rect(x - radius, y - radius, size, size, pixel)
+
+    def line(self, x1, y1, x2, y2, size, pixel):
+        dx, sx = abs(x2 - x1), 1 if x1 < x2 else -1
+        dy, sy = abs(y2 - y1), 1 if y1 < y2 else -1
+        err = int((dx if dx > dy else -dy) / 2)
+
+        while True:
+            self.point(x1, y1, size, pixel)
+            if x1 == x2 and y1 == y2:
+                break
+
+            err2 = err
+            if err2 > -dx:
+                err -= dy
+                x1 += sx
+            if err2 < dy:
+                err += dx
+                y1 += sy
+
+
+# Default slot_colors parameter
+SLOT_COLORS = [
+    0xFFFFFFFF, 0xFFE53935, 0xFF43A047, 0xFF1E88E5, 0xFFFDD835,
+    0xFF8E24AA, 0xFFFB8C00, 0xFF00ACC1, 0xFFD81B60, 0xFFC0CA33,
+]
+
+
+def model_paint(events, fb, brush_size):
+    """Models touchpaint_input_event() in paint mode with the default clear delay"""
+    slots = [[-1, -1] for _ in range(MAX_SLOTS)]
+    last = [[0, 0] for _ in range(MAX_SLOTS)]
+    down = [False] * MAX_SLOTS
+    fingers = 0
+    slot = 0
+    rendered = False
+    rendered_frames = 0
+
+    for ev_type, code, value in events:
+        if ev_type == EV_ABS:
+            if code == ABS_MT_SLOT:
+                slot = value
+            elif code == ABS_MT_POSITION_X:
+                slots[slot][0] = value
+            elif code == ABS_MT_POSITION_Y:
+                slots[slot][1] = value
+            elif code == ABS_MT_TRACKING_ID and value == -1:
+                if down[slot]:
+                    fingers -= 1
+                    down[slot] = False
+                    last[slot] = [0, 0]
+                slots[slot] = [-1, -1]
+
+        if (ev_type == EV_ABS and code == ABS_MT_SLOT) or \
+                (ev_type == EV_SYN and code == SYN_REPORT):
+            x, y = slots[slot]
+            if x != -1 and y != -1:
+                if not down[slot]:
+                    down[slot] = True
+                    fingers += 1
+                    if fingers == 1:
+                        fb.clear()
+
+                rendered = True
+                color = SLOT_COLORS[slot]
+                fb.point(x, y, brush_size, color)
+                if last[slot][0] and last[slot][1]:
+                    fb.line(x, y, last[slot][0], last[slot][1], brush_size, color)
+                last[slot] = [x, y]
+
+        if ev_type == EV_SYN and code == SYN_REPORT:
+            rendered_frames += rendered
+            rendered = False
+
+    return rendered_frames
+
+
+def parse_stats(log_path):
+    stats = {}
+    with open(log_path, errors="replace") as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) == 9 and re.fullmatch(r"\d+", fields[1]):
+                stats[fields[0]] = [int(v) for v in fields[1:]]
+
+    return stats
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--mem", required=True, help="QEMU memory backend file")
+    parser.add_argument("--ram-base", type=lambda v: int(v, 0), default=0x40000000)
+    parser.add_argument("--fb-addr", type=lambda v: int(v, 0), default=0xA0000000)
+    parser.add_argument("--width", type=int, default=1080)
+    parser.add_argument("--height", type=int, default=2340)
+    parser.add_argument("--brush-size", type=int, default=2)
+    parser.add_argument("--log", help="guest serial log containing the stats dump")
+    parser.add_argument("--max-p99-us", type=int, help="fail if p99 render time exceeds this")
+    parser.add_argument("trace")
+    args = parser.parse_args()
+
+    fb = Framebuffer(args.width, args.height)
+    frames = model_paint(input_core_filter(trace_to_events(load_trace(args.trace))),
+                         fb, args.brush_size)
+
+    with open(args.mem, "rb") as f:
+        f.seek(args.fb_addr - args.ram_base)
+        actual = f.read(len(fb.mem))
+
+    failed = False
+    if actual != fb.mem:
+        bad = [i // 4 for i in range(0, len(fb.mem), 4) if actual[i:i + 4] != fb.mem[i:i + 4]]
+        first = bad[0]
+        print(f"FAIL: {len(bad)} pixels differ, first at ({first % args.width}, "
+              f"{first // args.width}): got {actual[first * 4:first * 4 + 4].hex()}, "
+              f"expected {fb.mem[first * 4:first * 4 + 4].hex()}")
+        failed = True
+    else:
+        print(f"framebuffer matches the expected output of {frames} rendered frames")
+
+    if args.log:
+        stats = parse_stats(args.log)
+        render = stats.get("render")
+        if render is None:
+            print("FAIL: no render stats in the guest log")
+            failed = True
+        else:
+            count, p99 = render[0], render[6]
+            print(f"render: {count} frames, p50 {render[4]} ns, p99 {p99} ns, max {render[7]} ns")
+            if count != frames:
+                print(f"FAIL: kernel rendered {count} frames, expected {frames}")
+                failed = True
+            if args.max_p99_us is not None and p99 > args.max_p99_us * 1000:
+                print(f"FAIL: p99 render time exceeds {args.max_p99_us} us")
+                failed = True
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,51 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# Builds a minimal initramfs that replays a trace through Touchpaint, dumps
+# its stats to the console, and powers off.
+#
+# usage: mkinitramfs.sh <static busybox> <static touchpaint-replay> <trace> <output.cpio.gz>
+
+set -eu
+
+if [ $# -ne 4 ]; then
+	echo "usage: $0 busybox touchpaint-replay trace output.cpio.gz" >&2
+	exit 1
+fi
+
+busybox=$1
+replay=$2
+trace=$3
+out=$(realpath "$4")
+root=$(mktemp -d)
+trap 'rm -rf "$root"' EXIT
+
+mkdir -p "$root/bin" "$root/dev" "$root/proc" "$root/sys"
+cp "$busybox" "$root/bin/busybox"
+cp "$replay" "$root/bin/touchpaint-replay"
+cp "$trace" "$root/trace"
+for cmd in sh mount cat echo sync poweroff sleep; do
+	ln -s busybox "$root/bin/$cmd"
+done
+
+cat > "$root/init" <<'INIT'
+#!/bin/sh
+mount -t devtmpfs devtmpfs /dev
+mount -t proc proc /proc
+mount -t sysfs sysfs /sys
+mount -t debugfs debugfs /sys/kernel/debug
+
+params=/sys/module/touchpaint/parameters
+echo 1 > /sys/kernel/debug/touchpaint/stats
+/bin/touchpaint-replay -W "$(cat $params/fb_width)" -H "$(cat $params/fb_height)" /trace
+
+echo "=== touchpaint stats ==="
+cat /sys/kernel/debug/touchpaint/stats
+echo "=== end ==="
+
+sync
+poweroff -f
+INIT
+chmod +x "$root/init"
+
+(cd "$root" && find . | cpio -o -H newc --quiet | gzip -9) > "$out"
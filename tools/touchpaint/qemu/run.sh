@@ -0,0 +1,60 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# Boots a Touchpaint kernel on QEMU's arm64 virt machine, replays a trace
+# through a uinput touchscreen, and checks the rendered framebuffer.
+#
+# The kernel is limited to the bottom of guest RAM with mem=, and the
+# framebuffer is placed in the RAM above it. Guest RAM is backed by a shared
+# file in /dev/shm so check.py can read the framebuffer from the host once
+# the guest powers off.
+#
+# usage: run.sh <Image> <initramfs.cpio.gz> <trace>
+#
+# Environment:
+#   QEMU        QEMU binary (default: qemu-system-aarch64)
+#   WIDTH       framebuffer width (default: 1080)
+#   HEIGHT      framebuffer height (default: 2340)
+#   BRUSH_SIZE  Touchpaint brush size (default: 2)
+#   MAX_P99_US  fail if the p99 render time exceeds this many microseconds
+
+set -eu
+
+if [ $# -ne 3 ]; then
+	echo "usage: $0 Image initramfs.cpio.gz trace" >&2
+	exit 1
+fi
+
+kernel=$1
+initrd=$2
+trace=$3
+dir=$(dirname "$0")
+
+QEMU=${QEMU:-qemu-system-aarch64}
+WIDTH=${WIDTH:-1080}
+HEIGHT=${HEIGHT:-2340}
+BRUSH_SIZE=${BRUSH_SIZE:-2}
+
+# 2 GiB of RAM at 0x40000000; the kernel gets the bottom 1.5 GiB
+ram_size=2G
+ram_base=0x40000000
+fb_addr=0xa0000000
+fb_size=$(printf '0x%x' $((WIDTH * HEIGHT * 4)))
+
+mem=/dev/shm/touchpaint-qemu-$$
+log=$(mktemp)
+trap 'rm -f "$mem" "$log"' EXIT
+
+"$QEMU" -machine virt,gic-version=3,memory-backend=ram \
+	-cpu max -smp 4 -m "$ram_size" \
+	-object memory-backend-file,id=ram,size="$ram_size",mem-path="$mem",share=on \
+	-nographic -no-reboot \
+	-kernel "$kernel" -initrd "$initrd" \
+	-append "console=ttyAMA0 mem=1536M rdinit=/init \
+touchpaint.fb_phys_addr=$fb_addr touchpaint.fb_max_size=$fb_size \
+touchpaint.fb_width=$WIDTH touchpaint.fb_height=$HEIGHT \
+touchpaint.brush_size=$BRUSH_SIZE" | tee "$log"
+
+"$dir/check.py" --mem "$mem" --ram-base "$ram_base" --fb-addr "$fb_addr" \
+	--width "$WIDTH" --height "$HEIGHT" --brush-size "$BRUSH_SIZE" \
+	--log "$log" ${MAX_P99_US:+--max-p99-us "$MAX_P99_US"} "$trace"
@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Replays a multitouch trace through a uinput device.
+ *
+ * Trace format, one sample per line (blank lines and '#' comments ignored):
+ *
+ *   <time_us> <slot> <x> <y>	finger in <slot> is down at (x, y)
+ *   <time_us> <slot> up		finger in <slot> was lifted
+ *
+ * Samples with the same timestamp are reported in one frame, i.e. followed
+ * by a single SYN_REPORT. check.py converts traces into events the same way.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+
+#define MAX_SLOTS 10
+
+struct sample {
+	long long time_us;
+	int slot;
+	int x;
+	int y;
+	bool up;
+};
+
+static int width = 1080;
+static int height = 2340;
+
+static void emit(int fd, int type, int code, int value)
+{
+	struct input_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = type;
+	ev.code = code;
+	ev.value = value;
+
+	if (write(fd, &ev, sizeof(ev)) != sizeof(ev)) {
+		perror("write");
+		exit(1);
+	}
+}
+
+static void setup_abs(int fd, int code, int min, int max)
+{
+	struct uinput_abs_setup abs;
+
+	memset(&abs, 0, sizeof(abs));
+	abs.code = code;
+	abs.absinfo.minimum = min;
+	abs.absinfo.maximum = max;
+
+	if (ioctl(fd, UI_ABS_SETUP, &abs)) {
+		perror("UI_ABS_SETUP");
+		exit(1);
+	}
+}
+
+static int create_device(void)
+{
+	struct uinput_setup setup;
+	int fd;
+
+	fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+	if (fd < 0) {
+		perror("/dev/uinput");
+		exit(1);
+	}
+
+	ioctl(fd, UI_SET_EVBIT, EV_SYN);
+	ioctl(fd, UI_SET_EVBIT, EV_ABS);
+	ioctl(fd, UI_SET_ABSBIT, ABS_MT_SLOT);
+	ioctl(fd, UI_SET_ABSBIT, ABS_MT_TRACKING_ID);
+	ioctl(fd, UI_SET_ABSBIT, ABS_MT_POSITION_X);
+	ioctl(fd, UI_SET_ABSBIT, ABS_MT_POSITION_Y);
+	ioctl(fd, UI_SET_PROPBIT, INPUT_PROP_DIRECT);
+
+	setup_abs(fd, ABS_MT_SLOT, 0, MAX_SLOTS - 1);
+	setup_abs(fd, ABS_MT_TRACKING_ID, 0, 65535);
+	setup_abs(fd, ABS_MT_POSITION_X, 0, width - 1);
+	setup_abs(fd, ABS_MT_POSITION_Y, 0, height - 1);
+
+	memset(&setup, 0, sizeof(setup));
+	setup.id.bustype = BUS_VIRTUAL;
+	setup.id.vendor = 0x7470;
+	setup.id.product = 0x0001;
+	strcpy(setup.name, "touchpaint-replay");
+
+	if (ioctl(fd, UI_DEV_SETUP, &setup) || ioctl(fd, UI_DEV_CREATE)) {
+		perror("uinput device creation");
+		exit(1);
+	}
+
+	return fd;
+}
+
+static struct sample *load_trace(const char *path, int *count)
+{
+	struct sample *samples = NULL;
+	int nr = 0, cap = 0;
+	char line[256];
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		struct sample s = { 0 };
+		char arg[16];
+		int n;
+
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		n = sscanf(line, "%lld %d %15s %d", &s.time_us, &s.slot, arg, &s.y);
+		if (n == 3 && !strcmp(arg, "up")) {
+			s.up = true;
+		} else if (n == 4) {
+			s.x = atoi(arg);
+		} else {
+			fprintf(stderr, "invalid trace line: %s", line);
+			exit(1);
+		}
+
+		if (s.slot < 0 || s.slot >= MAX_SLOTS) {
+			fprintf(stderr, "invalid slot %d\n", s.slot);
+			exit(1);
+		}
+
+		if (nr == cap) {
+			cap = cap ? cap * 2 : 256;
+			samples = realloc(samples, cap * sizeof(*samples));
+			if (!samples) {
+				perror("realloc");
+				exit(1);
+			}
+		}
+
+		samples[nr++] = s;
+	}
+
+	fclose(f);
+	*count = nr;
+	return samples;
+}
+
+static long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void sleep_until_us(long long target)
+{
+	struct timespec ts = {
+		.tv_sec = target / 1000000,
+		.tv_nsec = (target % 1000000) * 1000,
+	};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+int main(int argc, char **argv)
+{
+	bool active[MAX_SLOTS] = { false };
+	struct sample *samples;
+	long long start, late_max = 0;
+	int tracking_id = 0;
+	int cur_slot = 0;
+	int nr, frames = 0;
+	int opt, fd, i;
+
+	while ((opt = getopt(argc, argv, "W:H:")) != -1) {
+		switch (opt) {
+		case 'W':
+			width = atoi(optarg);
+			break;
+		case 'H':
+			height = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (optind != argc - 1)
+		goto usage;
+
+	samples = load_trace(argv[optind], &nr);
+	fd = create_device();
+
+	/* Give input handlers time to connect to the new device */
+	sleep(1);
+
+	start = now_us();
+	for (i = 0; i < nr; ) {
+		long long t = samples[i].time_us;
+		long long late;
+
+		sleep_until_us(start + t);
+
+		for (; i < nr && samples[i].time_us == t; i++) {
+			struct sample *s = &samples[i];
+
+			if (s->slot != cur_slot) {
+				emit(fd, EV_ABS, ABS_MT_SLOT, s->slot);
+				cur_slot = s->slot;
+			}
+
+			if (s->up) {
+				emit(fd, EV_ABS, ABS_MT_TRACKING_ID, -1);
+				active[s->slot] = false;
+				continue;
+			}
+
+			if (!active[s->slot]) {
+				emit(fd, EV_ABS, ABS_MT_TRACKING_ID, tracking_id++);
+				active[s->slot] = true;
+			}
+
+			emit(fd, EV_ABS, ABS_MT_POSITION_X, s->x);
+			emit(fd, EV_ABS, ABS_MT_POSITION_Y, s->y);
+		}
+
+		emit(fd, EV_SYN, SYN_REPORT, 0);
+		frames++;
+
+		late = now_us() - (start + t);
+		if (late > late_max)
+			late_max = late;
+	}
+
+	printf("replayed %d samples in %d frames, max injection delay %lld us\n",
+	       nr, frames, late_max);
+
+	ioctl(fd, UI_DEV_DESTROY);
+	close(fd);
+	free(samples);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-W width] [-H height] trace\n", argv[0]);
+	return 1;
+}